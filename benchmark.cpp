@@ -0,0 +1,236 @@
+// benchmark.cpp
+
+#include "benchmark.hpp"
+#include "chunk_grid.hpp"
+
+#include <array>
+#include <memory>
+#include <random>
+#include <sstream>
+
+std::string benchmark_meshers(std::vector<CubicChunk>& chunks, Stopwatch& stopwatch)
+{
+	static constexpr CubicChunk::Mesher meshers[] = {
+		CubicChunk::Mesher::Scan,
+		CubicChunk::Mesher::Bitmask,
+		CubicChunk::Mesher::Specialised,
+	};
+	static constexpr const char* mesher_names[] = { "scan", "bm", "spec" };
+
+	if (chunks.empty())
+		return "";
+
+	// The first build also fills in visible_rows, which isn't what we
+	// 	want to time, so get every chunk past that first
+	for (CubicChunk& chunk : chunks)
+		while (!chunk.advance_mesh_steps(CubicChunk::size));
+
+	const CubicChunk::Mesher original_mesher = chunks[0].get_mesher();
+
+	std::stringstream ss;
+	ss.precision(3);
+	for (bool textured : { true, false })
+	{
+		ss << (textured ? "tex ms:" : "col ms:");
+		for (int i = 0; i < 3; ++i)
+		{
+			const double start_ms = stopwatch.get_ms();
+			for (CubicChunk& chunk : chunks)
+			{
+				// main sets the LOD again next frame
+				chunk.set_lod(textured, CubicChunk::dim);
+				chunk.set_mesher(meshers[i]);
+				chunk.rebuild_mesh();
+				while (!chunk.advance_mesh_steps(CubicChunk::size));
+			}
+			ss << " " << mesher_names[i] << "=" << stopwatch.get_ms() - start_ms;
+		}
+		ss << "\n";
+	}
+
+	for (CubicChunk& chunk : chunks)
+		chunk.set_mesher(original_mesher);
+
+	return ss.str();
+}
+
+std::string benchmark_layout(const CubicChunk& chunk, Stopwatch& stopwatch)
+{
+	static constexpr int edit_count = 256;
+	static constexpr int rebuild_count = 8;
+
+	// A chunk is too big to copy onto the calculator's stack
+	const std::unique_ptr<CubicChunk> copy = std::make_unique<CubicChunk>(chunk);
+	while (!copy->advance_mesh_steps(CubicChunk::size));
+
+	// Same edits every run, so that builds can be compared
+	std::mt19937 rng{ 1 };
+
+	const double edits_start_ms = stopwatch.get_ms();
+	for (int i = 0; i < edit_count; ++i)
+	{
+		const int x = rng() % CubicChunk::dim;
+		const int y = rng() % CubicChunk::dim;
+		const int z = rng() % CubicChunk::dim;
+		copy->set_block(x, y, z, rng() % 4);
+	}
+	const double edits_ms = stopwatch.get_ms() - edits_start_ms;
+
+	const double rebuild_start_ms = stopwatch.get_ms();
+	for (int i = 0; i < rebuild_count; ++i)
+	{
+		copy->rebuild_mesh();
+		while (!copy->advance_mesh_steps(CubicChunk::size));
+	}
+	const double rebuild_ms = (stopwatch.get_ms() - rebuild_start_ms) / rebuild_count;
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << CubicChunk::Layout::name << ": " << edit_count << " edits=" << edits_ms;
+	ss << "ms rebuild=" << rebuild_ms << "ms\n";
+	return ss.str();
+}
+
+// Side length in blocks of the world benchmark_chunk_sizes() builds. Has to
+// 	be a multiple of every size it compares.
+static constexpr int size_benchmark_world_dim = 32;
+
+template <class Chunk>
+static void benchmark_chunk_size(std::stringstream& ss, VECTOR3 camera_pos,
+	RenderScratch& scratch, Stopwatch& stopwatch)
+{
+	static constexpr int chunks_per_side = size_benchmark_world_dim / Chunk::dim;
+	BasicChunkGrid<Chunk> world{ chunks_per_side, chunks_per_side, chunks_per_side,
+		CubicChunkBase::MissingNeighbour::Air };
+	std::vector<Chunk>& chunks = world.get_chunks();
+
+	// Full detail everywhere, like the chunks near the player
+	const double mesh_start_ms = stopwatch.get_ms();
+	for (Chunk& chunk : chunks)
+	{
+		chunk.set_lod(true, Chunk::dim);
+		while (!chunk.advance_mesh_steps(Chunk::size));
+	}
+	const double mesh_ms = stopwatch.get_ms() - mesh_start_ms;
+
+	// The T key only checks the game's chunk size, so check this one here
+	bool meshers_agree = true;
+	for (const Chunk& chunk : chunks)
+		meshers_agree = meshers_agree && chunk.meshers_agree();
+
+	// render() logs its own timings, which we don't want in the results
+	std::stringstream render_log;
+	unsigned int draw_calls = 0;
+	unsigned int chunks_culled = 0;
+	unsigned int quads_drawn = 0;
+	unsigned int quads_inside = 0;
+	unsigned int quads_skipped = 0;
+	unsigned int bytes = 0;
+
+	const double draw_start_ms = stopwatch.get_ms();
+	world.cull(Frustum::from_transformation(*transformation));
+	for (Chunk& chunk : chunks)
+	{
+		chunk.render(camera_pos, scratch, render_log, stopwatch);
+		const CubicChunkBase::RenderStats& stats = chunk.get_render_stats();
+		draw_calls += stats.draw_calls;
+		chunks_culled += stats.culled;
+		quads_drawn += stats.quads_drawn;
+		quads_inside += stats.quads_inside;
+		quads_skipped += stats.quads_skipped;
+		bytes += chunk.memory_usage();
+	}
+	const double draw_ms = stopwatch.get_ms() - draw_start_ms;
+
+	const unsigned int quads = quads_drawn + quads_skipped;
+	ss << Chunk::dim << ": mesh=" << mesh_ms << "ms draw=" << draw_ms << "ms ";
+	ss << draw_calls << " calls " << bytes / 1024 << "KB";
+	ss << (meshers_agree ? "" : " (MISMATCH)") << "\n";
+	ss << "  culled " << chunks_culled << "/" << chunks.size() << " chunks in ";
+	ss << world.get_cull_box_tests() << " tests, ";
+	ss << (quads ? quads_skipped * 100 / quads : 0) << "% quads, ";
+	ss << (quads_drawn ? quads_inside * 100 / quads_drawn : 0) << "% drawn inside\n";
+}
+
+std::string benchmark_chunk_sizes(VECTOR3 camera_pos, Stopwatch& stopwatch)
+{
+	// Its own scratch, since drawing 32^3 chunks grows the buffers to fit
+	// 	them for good, and the game's is meant to stay chunk-sized
+	const std::unique_ptr<RenderScratch> scratch = std::make_unique<RenderScratch>();
+
+	std::stringstream ss;
+	ss.precision(3);
+	benchmark_chunk_size<BasicCubicChunk<8>>(ss, camera_pos, *scratch, stopwatch);
+	benchmark_chunk_size<BasicCubicChunk<16>>(ss, camera_pos, *scratch, stopwatch);
+	benchmark_chunk_size<BasicCubicChunk<32>>(ss, camera_pos, *scratch, stopwatch);
+	ss << "scratch " << scratch->memory_usage() / 1024 << "KB shared\n";
+	return ss.str();
+}
+
+static GLFix raw_fix(int32_t raw)
+{
+	GLFix f;
+	f.value = raw;
+	return f;
+}
+
+std::string benchmark_projection(Stopwatch& stopwatch)
+{
+	static constexpr int dim = CubicChunk::dim;
+	static constexpr int basis_count = 8;
+	using Lattice = LatticeProjection<dim>;
+
+	// Every lattice point, in the structure-of-arrays form project() takes
+	std::vector<int16_t> xs, ys, zs;
+	for (int z = 0; z <= dim; ++z)
+		for (int y = 0; y <= dim; ++y)
+			for (int x = 0; x <= dim; ++x)
+			{
+				xs.push_back(x);
+				ys.push_back(y);
+				zs.push_back(z);
+			}
+	const int count = xs.size();
+
+	// Chunk sides span a few hundred units on screen, and can point
+	// 	any way. Same bases every run, so that builds can be compared.
+	std::mt19937 rng{ 1 };
+	std::uniform_int_distribution<int32_t> origin_raw{ -(1 << 20), 1 << 20 };
+	std::uniform_int_distribution<int32_t> edge_raw{ -(1 << 17), 1 << 17 };
+	std::array<Lattice, basis_count> lattices;
+	for (Lattice& lattice : lattices)
+	{
+		lattice.origin = VECTOR3{ raw_fix(origin_raw(rng)), raw_fix(origin_raw(rng)), raw_fix(origin_raw(rng)) };
+		for (VECTOR3& edge : lattice.edges)
+			edge = VECTOR3{ raw_fix(edge_raw(rng)), raw_fix(edge_raw(rng)), raw_fix(edge_raw(rng)) };
+	}
+
+	std::vector<VECTOR3> reference(count);
+	std::vector<GLFix> out_x(count), out_y(count), out_z(count);
+	double reference_ms = 0;
+	double kernel_ms = 0;
+	unsigned int mismatches = 0;
+	for (const Lattice& lattice : lattices)
+	{
+		const double reference_start_ms = stopwatch.get_ms();
+		for (int i = 0; i < count; ++i)
+			reference[i] = lattice.at(xs[i], ys[i], zs[i]);
+		reference_ms += stopwatch.get_ms() - reference_start_ms;
+
+		const double kernel_start_ms = stopwatch.get_ms();
+		lattice.project(xs.data(), ys.data(), zs.data(), count, out_x.data(), out_y.data(), out_z.data());
+		kernel_ms += stopwatch.get_ms() - kernel_start_ms;
+
+		for (int i = 0; i < count; ++i)
+			mismatches += reference[i].x.value != out_x[i].value ||
+				reference[i].y.value != out_y[i].value ||
+				reference[i].z.value != out_z[i].value;
+	}
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "projection (" << Lattice::kernel_name << ", " << basis_count * count << " pts): ";
+	ss << "at=" << reference_ms << "ms batch=" << kernel_ms << "ms ";
+	ss << mismatches << " mismatches\n";
+	return ss.str();
+}
@@ -0,0 +1,37 @@
+// benchmark.hpp
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "chunk.hpp"
+#include "timer.hpp"
+
+// Rebuilds every chunk's mesh from scratch with each mesher, textured and
+//	untextured, and returns how long each took as text for the debug overlay.
+//	This takes a while (all of the meshing happens right away), so only
+//	run it when asked to.
+//	stopwatch must already be running; it isn't restarted.
+std::string benchmark_meshers(std::vector<CubicChunk>& chunks, Stopwatch& stopwatch);
+
+// Times random block edits (each remeshes the slices it touches) and full
+//	rebuilds on a copy of chunk, for comparing block layouts. The layout is
+//	picked at compile time, so build once with each BLOCK_LAYOUT and compare.
+std::string benchmark_layout(const CubicChunk& chunk, Stopwatch& stopwatch);
+
+// Builds the same world out of 8^3, 16^3 and 32^3 chunks, meshes all of it
+//	and draws it once from camera_pos, then reports for each size how long
+//	meshing and drawing took, how many draw calls it made, how much got
+//	culled (whole chunks off screen, and quads facing away), how many of
+//	the drawn quads came from chunks entirely inside the frustum and how
+//	much memory the chunks used, and flags any size whose meshers disagree.
+//	It draws with the current matrix, so call it once the camera is set
+//	up, and clear the screen after.
+std::string benchmark_chunk_sizes(VECTOR3 camera_pos, Stopwatch& stopwatch);
+
+// Projects every lattice point of a chunk with a few random
+//	LatticeProjections, once with at() one point at a time and once with
+//	the batched project(), and reports how long each took and how many
+//	points they disagreed on (which should be none).
+std::string benchmark_projection(Stopwatch& stopwatch);
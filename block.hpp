@@ -15,6 +15,10 @@ class Block
 public:
 	static constexpr int block_size = 32;
 	static constexpr GLFix tex_size = 16;
+	// Each block texture is tiled this many times across and down in the
+	//	spritesheet (see tile_image in assets/spritesheet_gen.py), so a
+	//	textured quad can span at most tex_repeat x tex_repeat blocks.
+	static constexpr int tex_repeat = 4;
 
 private:
 	static const std::array<VERTEX, 24> origin_cube_vertices;
@@ -32,3 +36,7 @@ public:
 	void write_ivertices(std::vector<IndexedVertex>& iverts, VECTOR3 subchunk_pos, std::array<bool, 6> faces) const;
 };
 
+// Anything else a block needs to remember goes in BlockMetadata
+// 	(block_metadata.hpp), so that chunks stay dense arrays of block types
+static_assert(sizeof(Block) == sizeof(blocktype_t), "Block should only hold its type");
+
@@ -0,0 +1,71 @@
+// block_layout.hpp
+
+#pragma once
+
+#include "ivec3.hpp"
+
+// How a chunk's blocks (and everything indexed like them) are laid out
+// 	in memory. CubicChunk picks one at compile
+// 	time, see BLOCK_LAYOUT in the Makefile.
+//
+// Both layouts build an index out of one offset per axis, so
+// 	idx = offset(0, x) + offset(1, y) + offset(2, z). Code that walks a
+// 	slice can work out the offsets of a row or column once and then just
+// 	add them up.
+
+// x + dim * y + dim * dim * z. Walking along x is sequential, but a step
+// 	along z jumps dim * dim entries.
+template <int dim>
+struct LinearLayout
+{
+	static constexpr const char* name = "linear";
+
+	static constexpr int offset(int axis, int c)
+	{
+		return axis == 0 ? c : axis == 1 ? c * dim : c * dim * dim;
+	}
+
+	static constexpr ivec3 coords(int idx)
+	{
+		return ivec3{ idx % dim, (idx / dim) % dim, idx / (dim * dim) };
+	}
+};
+
+// Z-order: the bits of x, y and z are interleaved (...z1 y1 x1 z0 y0 x0), so
+// 	blocks that are close in any direction are usually close in memory, and
+// 	each 2x2x2, 4x4x4, ... cube is one contiguous run of entries.
+template <int dim>
+struct MortonLayout
+{
+	static_assert((dim & (dim - 1)) == 0, "Morton layout needs a power of two chunk size");
+
+	static constexpr const char* name = "morton";
+
+	// Moves bit i of c to bit 3 * i
+	static constexpr int spread(int c)
+	{
+		int spread_c = 0;
+		for (int bit = 0; (1 << bit) < dim; ++bit)
+			spread_c |= ((c >> bit) & 1) << (3 * bit);
+		return spread_c;
+	}
+
+	// Undoes spread()
+	static constexpr int compact(int spread_c)
+	{
+		int c = 0;
+		for (int bit = 0; (1 << bit) < dim; ++bit)
+			c |= ((spread_c >> (3 * bit)) & 1) << bit;
+		return c;
+	}
+
+	static constexpr int offset(int axis, int c)
+	{
+		return spread(c) << axis;
+	}
+
+	static constexpr ivec3 coords(int idx)
+	{
+		return ivec3{ compact(idx), compact(idx >> 1), compact(idx >> 2) };
+	}
+};
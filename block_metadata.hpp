@@ -0,0 +1,64 @@
+// block_metadata.hpp
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+// Extra state for the few blocks that need more than a type, such as which
+//	way a block faces or how far a plant has grown. A default-constructed
+//	BlockMetadata means "no extra state".
+struct BlockMetadata
+{
+	uint8_t orientation = 0;	// face direction, numbered like face_normals
+	uint8_t growth_stage = 0;
+	uint16_t extra = 0;
+
+	bool operator==(const BlockMetadata& other) const
+	{
+		return orientation == other.orientation &&
+			growth_stage == other.growth_stage && extra == other.extra;
+	}
+	bool operator!=(const BlockMetadata& other) const { return !(*this == other); }
+};
+
+// Sparse BlockMetadata for one chunk, keyed on the block's index within the
+//	chunk. Only blocks with non-default metadata have an entry, so a chunk
+//	pays nothing for this until it has such a block, and adding fields here
+//	doesn't make the dense block storage (or the meshers reading it) any bigger.
+class BlockMetadataTable
+{
+private:
+	std::unordered_map<uint16_t, BlockMetadata> entries;
+
+public:
+	// nullptr if the block has no metadata
+	const BlockMetadata* get(int idx) const
+	{
+		auto it = entries.find(uint16_t(idx));
+		return it == entries.end() ? nullptr : &it->second;
+	}
+
+	// Setting the default metadata removes the block's entry
+	void set(int idx, const BlockMetadata& metadata)
+	{
+		if (metadata == BlockMetadata{})
+			entries.erase(uint16_t(idx));
+		else
+			entries[uint16_t(idx)] = metadata;
+	}
+
+	void erase(int idx) { entries.erase(uint16_t(idx)); }
+
+	unsigned int count() const { return entries.size(); }
+
+	// An estimate, since we can't see the allocator: one node (key, value
+	//	and next pointer) per entry, plus the bucket array
+	unsigned int memory_usage() const
+	{
+		using node_t = std::pair<uint16_t, BlockMetadata>;
+		return sizeof(*this) +
+			entries.size() * (sizeof(node_t) + sizeof(void*)) +
+			(entries.empty() ? 0 : entries.bucket_count() * sizeof(void*));
+	}
+};
@@ -0,0 +1,163 @@
+// block_palette.hpp
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "block.hpp"
+
+// Stores `size` block types as indices into a palette of the types that are
+//	actually used. Each index is `bits` wide, where bits is the smallest of
+//	0, 1, 2, 4, 8 or 16 that fits the palette. A chunk of only air needs no
+//	indices at all, and terrain with a few block types needs 1-2 bits per
+//	block instead of a whole blocktype_t.
+//
+// NOTE: Palette entries aren't reclaimed when the last block of a type is
+//		replaced, so the index width only ever grows, until the palette
+//		would need more than 16 bits. Then it's rebuilt from the types still
+//		in use, which always fit since a chunk can't hold more than size.
+template <int size>
+class PalettedBlocks
+{
+private:
+	static_assert(size < (1 << 16), "Too many blocks for 16-bit palette indices");
+
+	std::vector<blocktype_t> palette;
+	std::vector<uint32_t> words;
+	int bits = 0;
+
+	// Index widths are powers of two, so an index never straddles two words
+	static unsigned int read_index(const std::vector<uint32_t>& words, int bits, int idx)
+	{
+		const int bit = idx * bits;
+		return (words[bit / 32] >> (bit % 32)) & ((1u << bits) - 1);
+	}
+
+	static void write_index(std::vector<uint32_t>& words, int bits, int idx, unsigned int value)
+	{
+		const int bit = idx * bits;
+		uint32_t& word = words[bit / 32];
+		const uint32_t mask = ((1u << bits) - 1) << (bit % 32);
+		word = (word & ~mask) | (uint32_t(value) << (bit % 32));
+	}
+
+	unsigned int index_at(int idx) const
+	{
+		return bits == 0 ? 0 : read_index(words, bits, idx);
+	}
+
+	void grow()
+	{
+		// Repack every index at twice the width
+		const int new_bits = bits == 0 ? 1 : bits * 2;
+		std::vector<uint32_t> new_words((size * new_bits + 31) / 32, 0);
+		for (int idx = 0; idx < size; ++idx)
+			write_index(new_words, new_bits, idx, index_at(idx));
+		words.swap(new_words);
+		bits = new_bits;
+	}
+
+	// Drops the palette entries that no block other than `skip` (which is
+	//	about to be overwritten) uses, and repacks the indices at the
+	//	narrowest width that fits what's left
+	void compact(int skip)
+	{
+		std::vector<int> remap(palette.size(), -1);
+		std::vector<blocktype_t> new_palette;
+		for (int idx = 0; idx < size; ++idx)
+		{
+			const unsigned int old_idx = index_at(idx);
+			if (idx != skip && remap[old_idx] < 0)
+			{
+				remap[old_idx] = new_palette.size();
+				new_palette.push_back(palette[old_idx]);
+			}
+		}
+		if (new_palette.empty())
+			new_palette.push_back(palette[index_at(skip)]);
+
+		int new_bits = 0;
+		while ((1u << new_bits) < new_palette.size())
+			new_bits = new_bits == 0 ? 1 : new_bits * 2;
+
+		std::vector<uint32_t> new_words((size * new_bits + 31) / 32, 0);
+		if (new_bits != 0)
+		{
+			for (int idx = 0; idx < size; ++idx)
+			{
+				// skip can point anywhere, so long as it's in range
+				const int new_idx = remap[index_at(idx)];
+				write_index(new_words, new_bits, idx, new_idx < 0 ? 0 : new_idx);
+			}
+		}
+		palette.swap(new_palette);
+		words.swap(new_words);
+		bits = new_bits;
+	}
+
+public:
+	explicit PalettedBlocks(blocktype_t fill = 0) : palette{ fill } {}
+
+	blocktype_t get(int idx) const { return palette[index_at(idx)]; }
+
+	void set(int idx, blocktype_t type)
+	{
+		unsigned int palette_idx = 0;
+		while (palette_idx < palette.size() && palette[palette_idx] != type)
+			++palette_idx;
+
+		if (palette_idx == palette.size())
+		{
+			if (palette.size() == (1u << 16))
+			{
+				compact(idx);
+				palette_idx = palette.size();
+			}
+			palette.push_back(type);
+			if (palette.size() > (1u << bits))
+				grow();
+		}
+
+		// With 0 bits every block is palette[0], which is what we just found
+		if (bits != 0)
+			write_index(words, bits, idx, palette_idx);
+	}
+
+	int get_bits() const { return bits; }
+
+	// True while every block is the same type (palette[0])
+	bool is_uniform() const { return bits == 0; }
+
+	unsigned int memory_usage() const
+	{
+		return sizeof(*this) +
+			palette.capacity() * sizeof(blocktype_t) +
+			words.capacity() * sizeof(uint32_t);
+	}
+
+	// Writes a pattern with more and more distinct types, so that the
+	//	indices grow through every width, and checks every block reads back
+	//	as what was last written to it.
+	static bool round_trip_ok()
+	{
+		PalettedBlocks blocks;
+		std::vector<blocktype_t> expected(size, 0);
+
+		for (int types : { 1, 2, 3, 5, 16, 17, 200, 300 })
+		{
+			for (int idx = (types * 13) % 7; idx < size; idx += 7)
+			{
+				const blocktype_t type = (idx * 31) % types;
+				blocks.set(idx, type);
+				expected[idx] = type;
+			}
+			for (int idx = 0; idx < size; ++idx)
+			{
+				if (blocks.get(idx) != expected[idx])
+					return false;
+			}
+		}
+		return true;
+	}
+};
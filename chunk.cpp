@@ -9,28 +9,111 @@
 
 static std::mt19937 rng;
 
-CubicChunk::CubicChunk(VECTOR3 pos) : pos(pos)
+// GLFix -> int conversions that round down/up regardless of sign
+static int fix_floor(GLFix x)
 {
-	for (unsigned int i = 0; i < blocks.size(); ++i)
+	int i = x;
+	return (GLFix{ i } > x) ? i - 1 : i;
+}
+
+static int fix_ceil(GLFix x)
+{
+	int i = x;
+	return (GLFix{ i } < x) ? i + 1 : i;
+}
+
+// nglDrawArray() only reads positions when it has to transform them itself
+// 	(reset_processed), so when we've already filled in the transformed
+// 	position of every vertex we draw, there's nothing to pass it.
+//
+// NOTE: nglDrawArray() clips every quad against the near plane and the
+//		screen, even for chunks that are entirely inside the frustum and so
+//		can't need it. nGL has no draw call that skips that, so every chunk
+//		goes through here; RenderStats::quads_inside counts the quads a
+//		clip-free draw call would take.
+static void draw_processed(const IndexedVertex* vertices, unsigned int count,
+	ProcessedPosition* processed, unsigned int processed_count)
+{
+	nglDrawArray(vertices, count, nullptr, processed_count, processed, GL_QUADS, false);
+}
+
+// Length of the run of set bits in row starting at bit a. The ~ turns the
+// 	first gap into the lowest set bit. Rows narrower than an unsigned always
+// 	have a gap above them, but a full 32-bit row needs 64 bits to have one.
+template <class row_t>
+static int run_length(row_t row, int a)
+{
+	if constexpr (sizeof(row_t) < sizeof(unsigned))
+		return __builtin_ctz(~(unsigned(row) >> a));
+	else
+		return __builtin_ctzll(~(uint64_t(row) >> a));
+}
+
+// Bits a to a + w - 1 set, for any w up to the width of row_t
+template <class row_t>
+static row_t run_bits(int a, int w)
+{
+	using wide_t = std::conditional_t<(sizeof(row_t) < sizeof(unsigned)), unsigned, uint64_t>;
+	return row_t(((wide_t(1) << w) - 1) << a);
+}
+
+template <int chunk_dim>
+BasicCubicChunk<chunk_dim>::BasicCubicChunk(VECTOR3 pos) : pos(pos)
+{
+	// Until we're told about our neighbours, treat them as air
+	padded_solid.fill(0);
+
+	// The terrain is a heightmap, so work out each column's height first.
+	// 	If the surface doesn't pass through the chunk, it's all air or all
+	// 	solid and we don't have to fill it in block by block.
+	std::array<GLFix, dim * dim> heights;
+	bool all_air = true;
+	bool all_solid = true;
+	for (int bz = 0; bz < dim; ++bz)
+	{
+		for (int bx = 0; bx < dim; ++bx)
+		{
+			int x = pos.x + bx;
+			int z = pos.z + bz;
+			GLFix height = (fast_sin(GLFix(x * 14)) + fast_sin(GLFix(z * 19)) * 2) + 4;
+			heights[bx + bz * dim] = height;
+			all_air = all_air && height < GLFix(int(pos.y));
+			all_solid = all_solid && height >= GLFix(int(pos.y + dim - 1));
+		}
+	}
+
+	blocktype_t type = 3; //(x + y + z) / 16 % 2 + 1;
+	if (all_solid)
+	{
+		blocks = PalettedBlocks<size>(type);
+		for (int z = 0; z < dim; ++z)
+			for (int y = 0; y < dim; ++y)
+				padded_solid[padded_row(y, z)] = inner_bits;
+	}
+	else if (!all_air)
 	{
-		Block& block = blocks[i];
-		VECTOR3 block_coords = coords_of_idx(i);
-		int x = pos.x + block_coords.x;
-		int y = pos.y + block_coords.y;
-		int z = pos.z + block_coords.z;
-		blocktype_t type = 3; //(x + y + z) / 16 % 2 + 1;
-		bool exists = (fast_sin(GLFix(x * 14)) + fast_sin(GLFix(z * 19)) * 2) + 4 >= GLFix(y);
-		block.set_type(type * exists);
+		for (int i = 0; i < size; ++i)
+		{
+			ivec3 block_coords = coords_of_idx(i);
+			int y = pos.y + block_coords.y;
+			bool exists = heights[block_coords.x + block_coords.z * dim] >= GLFix(y);
+			blocks.set(i, type * exists);
+			set_padded_solid(block_coords.x, block_coords.y, block_coords.z, type * exists != 0);
+		}
 	}
 	// blocks[coords_to_idx({0, 0, 0})].set_type(1);
 	// blocks[coords_to_idx({0, 0, 4})].set_type(2);
 	// blocks[coords_to_idx({4, 0, 0})].set_type(3);
 	// blocks[coords_to_idx({4, 0, 4})].set_type(4);
-	update_textures_by_dir();
-	update_iverts_by_dir();
+
+	// Our textures and first mesh get built over the next few frames
+	// 	by advance_mesh_for()
+	pending.visible_step = 0;
+	select_mesh();
 }
 
-const std::array<VECTOR3, 8> CubicChunk::corners = {
+template <int chunk_dim>
+const std::array<VECTOR3, 8> BasicCubicChunk<chunk_dim>::corners = {
 	VECTOR3{0, 0, 0},
 	VECTOR3{dim, 0, 0},
 	VECTOR3{0, dim, 0},
@@ -41,497 +124,1318 @@ const std::array<VECTOR3, 8> CubicChunk::corners = {
 	VECTOR3{dim, dim, dim},
 };
 
-const std::array<VECTOR3, 6> CubicChunk::face_toplefts = {
-	VECTOR3{0, 1, 1}, VECTOR3{1, 1, 0},
-	VECTOR3{1, 0, 1}, VECTOR3{0, 1, 1},
-	VECTOR3{0, 1, 0}, VECTOR3{1, 1, 1} };
-
-const std::array<VECTOR3, 6> CubicChunk::face_u_orthos = {
-	VECTOR3{0, 0, -1}, VECTOR3{0, 0, 1},
-	VECTOR3{-1, 0, 0}, VECTOR3{1, 0, 0},
-	VECTOR3{1, 0, 0}, VECTOR3{-1, 0, 0} };
-
-const std::array<VECTOR3, 6> CubicChunk::face_v_orthos = {
-	VECTOR3{0, -1, 0}, VECTOR3{0, -1, 0},
-	VECTOR3{0, 0, -1}, VECTOR3{0, 0, -1},
-	VECTOR3{0, -1, 0}, VECTOR3{0, -1, 0} };
-
-VECTOR3 CubicChunk::coords_of_idx(int idx)
-{
-	int x = idx % dim;
-	int y = (idx / dim) % dim;
-	int z = idx / (dim * dim);
-	return VECTOR3{ x, y, z };
-}
-
-int CubicChunk::coords_to_idx(VECTOR3 coords)
+template <int chunk_dim>
+const std::array<ivec3_s8, 6> BasicCubicChunk<chunk_dim>::face_u_orthos = { {
+	{0, 0, -1}, {0, 0, 1},
+	{-1, 0, 0}, {1, 0, 0},
+	{1, 0, 0}, {-1, 0, 0} } };
+
+template <int chunk_dim>
+const std::array<ivec3_s8, 6> BasicCubicChunk<chunk_dim>::face_v_orthos = { {
+	{0, -1, 0}, {0, -1, 0},
+	{0, 0, -1}, {0, 0, -1},
+	{0, -1, 0}, {0, -1, 0} } };
+
+// The direction each face points in, i.e. towards the block it touches
+template <int chunk_dim>
+const std::array<ivec3_s8, 6> BasicCubicChunk<chunk_dim>::face_normals = { {
+	{-1, 0, 0}, {1, 0, 0},
+	{0, -1, 0}, {0, 1, 0},
+	{0, 0, -1}, {0, 0, 1} } };
+
+template <int chunk_dim>
+bool BasicCubicChunk<chunk_dim>::in_bounds(ivec3 coords)
 {
-	return coords.x + coords.y * dim + coords.z * dim * dim;
+	// Casting to unsigned turns negative coordinates into huge ones, so one
+	// 	comparison per axis is enough
+	return unsigned(coords.x) < unsigned(dim) &&
+		unsigned(coords.y) < unsigned(dim) &&
+		unsigned(coords.z) < unsigned(dim);
 }
 
-Block* CubicChunk::block_at(int x, int y, int z)
+template <int chunk_dim>
+blocktype_t BasicCubicChunk<chunk_dim>::block_at(int x, int y, int z) const
 {
+	// Anything outside the chunk counts as air
 	if (x < 0 || x >= dim ||
 		y < 0 || y >= dim ||
 		z < 0 || z >= dim)
-		return nullptr;
-	return &blocks[coords_to_idx({ x, y, z })];
+		return 0;
+	return blocks.get(coords_to_idx({ x, y, z }));
 }
 
-const Block* CubicChunk::block_at(int x, int y, int z) const
+template <int chunk_dim>
+const BlockMetadata* BasicCubicChunk<chunk_dim>::metadata_at(int x, int y, int z) const
 {
-	if (x < 0 || x >= dim ||
-		y < 0 || y >= dim ||
-		z < 0 || z >= dim)
+	if (!in_bounds({ x, y, z }))
 		return nullptr;
-	return &blocks[coords_to_idx({ x, y, z })];
+	return metadata.get(coords_to_idx({ x, y, z }));
 }
 
-bool CubicChunk::block_is_visible_from_side(int idx, int side)
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::set_metadata(int x, int y, int z, const BlockMetadata& block_metadata)
 {
-	VECTOR3 coords = coords_of_idx(idx);
-	switch (side)
-	{
-	case 0:
-		--coords.x;
-		break;
-	case 1:
-		++coords.x;
-		break;
-	case 2:
-		--coords.y;
-		break;
-	case 3:
-		++coords.y;
-		break;
-	case 4:
-		--coords.z;
-		break;
-	case 5:
-		++coords.z;
-		break;
-	}
-	const Block* block = block_at(coords.x, coords.y, coords.z);
-	return (block == nullptr || block->get_type() == 0);
+	if (in_bounds({ x, y, z }))
+		metadata.set(coords_to_idx({ x, y, z }), block_metadata);
 }
 
-std::array<IndexedVertex, 4> CubicChunk::get_ivert_quad(
-	VECTOR3 coords,
-	int tex, int face,
-	int u, int v)
+template <int chunk_dim>
+bool BasicCubicChunk<chunk_dim>::set_padded_solid(int x, int y, int z, bool solid)
 {
-	VECTOR3 tl = face_toplefts[face] + coords;
-	VECTOR3 tr = tl + face_u_orthos[face] * u;
-	VECTOR3 br = tr + face_v_orthos[face] * v;
-	VECTOR3 bl = tl + face_v_orthos[face] * v;
-
-	int axis = face / 2;
-	GLFix tex_u1 = Block::tex_size * axis * 4;
-	GLFix tex_v1 = Block::tex_size * tex * 4;
-	GLFix tex_u2 = tex_u1 + Block::tex_size * u;
-	GLFix tex_v2 = tex_v1 + Block::tex_size * v;
+	// Returns true if the block's solidity changed
+	padded_row_t& row = padded_solid[padded_row(y, z)];
+	const padded_row_t bit = padded_row_t(1) << (x + 1);
+	const padded_row_t new_row = solid ? (row | bit) : (row & ~bit);
+	if (new_row == row)
+		return false;
+	row = new_row;
+	return true;
+}
 
-	COLOR solid_color = using_textures ? 0 : texdata_colorsheet[tex * 3 + axis];
+template <int chunk_dim>
+int BasicCubicChunk<chunk_dim>::visible_texture(int face, ivec3 coords) const
+{
+	// The texture to draw on a face of a block, or 0 if it's hidden
+	if (!((visible_rows[face][coords.y + coords.z * dim] >> coords.x) & 1))
+		return 0;
+	return blocks.get(coords_to_idx(coords));
+}
 
-	return std::array<IndexedVertex, 4>{
-		IndexedVertex{ xyz_to_vert_idx(tl.x, tl.y, tl.z), tex_u1, tex_v1, solid_color },
-			IndexedVertex{ xyz_to_vert_idx(tr.x, tr.y, tr.z), tex_u2, tex_v1, solid_color },
-			IndexedVertex{ xyz_to_vert_idx(br.x, br.y, br.z), tex_u2, tex_v2, solid_color },
-			IndexedVertex{ xyz_to_vert_idx(bl.x, bl.y, bl.z), tex_u1, tex_v2, solid_color }};
+template <int chunk_dim>
+template <int face, bool textured>
+void BasicCubicChunk<chunk_dim>::expand_quads(const PackedQuad* quads, int count, IndexedVertex* out)
+{
+	// Turns packed quads back into the four corners nglDrawArray() wants:
+	// 	top-left, top-right, bottom-right, bottom-left, where right is along
+	// 	face_u_orthos and down is along face_v_orthos. Those can run towards
+	// 	the negative axis, so "top-left" isn't always the quad's lowest corner.
+	// 	As in mesh_slice_kernel(), the face is a template parameter so all the
+	// 	axis and stride choices are made at compile time.
+
+	constexpr FaceAxes axes = face_axes[face];
+	constexpr unsigned int vert_strides[3] = { 1, dim + 1, (dim + 1) * (dim + 1) };
+	constexpr unsigned int vert_stride_n = vert_strides[axes.normal];
+	constexpr unsigned int vert_stride_u = vert_strides[axes.u];
+	constexpr unsigned int vert_stride_v = vert_strides[axes.v];
+	constexpr int axis = face / 2;
+	const GLFix tex_u1 = Block::tex_size * (axis * Block::tex_repeat);
+
+	for (int i = 0; i < count; ++i, out += 4)
+	{
+		const PackedQuad quad = quads[i];
+		const int a0 = quad.a();
+		const int b0 = quad.b();
+		const int w = quad.w();
+		const int h = quad.h();
+
+		const int tl_u = axes.u_sign > 0 ? a0 : a0 + w;
+		const int tr_u = axes.u_sign > 0 ? a0 + w : a0;
+		const int tl_v = axes.v_sign > 0 ? b0 : b0 + h;
+		const int bl_v = axes.v_sign > 0 ? b0 + h : b0;
+
+		// Faces of + directions lie on the far side of their block
+		const unsigned int base = (quad.slice() + face % 2) * vert_stride_n;
+		const unsigned int tl = base + tl_u * vert_stride_u + tl_v * vert_stride_v;
+		const unsigned int tr = base + tr_u * vert_stride_u + tl_v * vert_stride_v;
+		const unsigned int br = base + tr_u * vert_stride_u + bl_v * vert_stride_v;
+		const unsigned int bl = base + tl_u * vert_stride_u + bl_v * vert_stride_v;
+
+		if constexpr (textured)
+		{
+			const GLFix tex_v1 = Block::tex_size * (quad.tex() * Block::tex_repeat);
+			const GLFix tex_u2 = tex_u1 + Block::tex_size * w;
+			const GLFix tex_v2 = tex_v1 + Block::tex_size * h;
+			out[0] = IndexedVertex{ tl, tex_u1, tex_v1, 0 };
+			out[1] = IndexedVertex{ tr, tex_u2, tex_v1, 0 };
+			out[2] = IndexedVertex{ br, tex_u2, tex_v2, 0 };
+			out[3] = IndexedVertex{ bl, tex_u1, tex_v2, 0 };
+		}
+		else
+		{
+			// Untextured quads get no UVs, since nothing samples them
+			const COLOR color = texdata_colorsheet[quad.tex() * 3 + axis];
+			out[0] = IndexedVertex{ tl, GLFix{ 0 }, GLFix{ 0 }, color };
+			out[1] = IndexedVertex{ tr, GLFix{ 0 }, GLFix{ 0 }, color };
+			out[2] = IndexedVertex{ br, GLFix{ 0 }, GLFix{ 0 }, color };
+			out[3] = IndexedVertex{ bl, GLFix{ 0 }, GLFix{ 0 }, color };
+		}
+	}
 }
 
-void CubicChunk::update_textures_by_dir()
+template <int chunk_dim>
+const std::array<typename BasicCubicChunk<chunk_dim>::QuadExpander, 12> BasicCubicChunk<chunk_dim>::quad_expanders = {
+	&BasicCubicChunk::expand_quads<0, false>, &BasicCubicChunk::expand_quads<0, true>,
+	&BasicCubicChunk::expand_quads<1, false>, &BasicCubicChunk::expand_quads<1, true>,
+	&BasicCubicChunk::expand_quads<2, false>, &BasicCubicChunk::expand_quads<2, true>,
+	&BasicCubicChunk::expand_quads<3, false>, &BasicCubicChunk::expand_quads<3, true>,
+	&BasicCubicChunk::expand_quads<4, false>, &BasicCubicChunk::expand_quads<4, true>,
+	&BasicCubicChunk::expand_quads<5, false>, &BasicCubicChunk::expand_quads<5, true>,
+};
+
+template <int chunk_dim>
+int BasicCubicChunk<chunk_dim>::merge_key(int tex, int face, bool textured)
 {
-	// This function updates the textures_by_dir array and should
-	// 	be called whenever the chunk's block data changes.
+	// Two faces can share a quad if they look the same. With textures that
+	// 	means the same block type, but untextured quads only show a colour
+	// 	from the colorsheet, which several block types can share.
+	if (textured)
+		return tex;
+	return texdata_colorsheet[tex * 3 + face / 2];
+}
 
-	// Loop through all blocks in the chunk
-	for (int i = 0; i < size; ++i)
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::push_quads(std::vector<PackedQuad>& quads,
+	ivec3 coords, int tex, int face,
+	int u, int v, bool textured)
+{
+	// Adds a u x v quad, growing from the block at coords along
+	// 	face_u_orthos/face_v_orthos, to quads. Without textures the quad is a
+	// 	single solid colour and can be any size, but a textured quad can only
+	// 	repeat its texture Block::tex_repeat times in each direction, so
+	// 	we cut it into pieces at those tile boundaries.
+	const FaceAxes& axes = face_axes[face];
+	const int piece_size = textured ? Block::tex_repeat : dim;
+
+	for (int v0 = 0; v0 < v; v0 += piece_size)
 	{
-		blocktype_t btype = blocks[i].get_type();
+		for (int u0 = 0; u0 < u; u0 += piece_size)
+		{
+			const ivec3 piece = coords + face_u_orthos[face] * u0 + face_v_orthos[face] * v0;
+			const int piece_coords[3] = { piece.x, piece.y, piece.z };
+			const int w = std::min(piece_size, u - u0);
+			const int h = std::min(piece_size, v - v0);
+
+			// PackedQuad wants the lowest corner, which is the far end of the
+			// 	piece if it grows towards the negative axis
+			const int a = axes.u_sign > 0 ? piece_coords[axes.u] : piece_coords[axes.u] - w + 1;
+			const int b = axes.v_sign > 0 ? piece_coords[axes.v] : piece_coords[axes.v] - h + 1;
+			quads.push_back(PackedQuad::make(piece_coords[axes.normal], a, b, w, h, tex));
+		}
+	}
+}
 
-		if (btype == 0)
+template <int chunk_dim>
+bool BasicCubicChunk<chunk_dim>::has_exposed_faces() const
+{
+	// Whether the chunk could have any visible faces. We only look closer
+	// 	at uniform chunks; anything else is assumed to have some.
+	if (!blocks.is_uniform())
+		return true;
+	if (blocks.get(0) == 0)
+		return false;
+
+	// A solid chunk only shows faces where it touches air in the halo.
+	// 	Its own rows must have both halo bits set, and the halo rows
+	// 	above/below/in front/behind must be solid over the chunk's width.
+	constexpr padded_row_t full = inner_bits | 1 | padded_row_t(1) << (dim + 1);
+	for (int i = 0; i < dim; ++i)
+	{
+		for (int j = 0; j < dim; ++j)
 		{
-			// If the block is air, don't render any of its faces
-			for (std::array<int, size>& arr : textures_by_dir)
-				arr[i] = 0;
+			if (padded_solid[padded_row(i, j)] != full)
+				return true;
 		}
-		else
+		for (int halo : { -1, dim })
 		{
-			// Otherwise, only render the faces that aren't occluded
-			for (int face = 0; face < 6; ++face)
-			{
-				textures_by_dir[face][i] = block_is_visible_from_side(i, face) ? btype : 0;
-			}
+			if ((padded_solid[padded_row(halo, i)] & inner_bits) != inner_bits ||
+				(padded_solid[padded_row(i, halo)] & inner_bits) != inner_bits)
+				return true;
 		}
 	}
+	return false;
 }
 
-void CubicChunk::set_greed_limit(int limit)
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::expose_faces()
 {
-	// if (limit > 4) limit = 4;
+	// Builds visible_rows for a chunk that skipped them because nothing was
+	// 	exposed, and remeshes it whole (its old mesh was empty, so there are
+	// 	no slices to patch). If the first build hasn't got to visible_rows
+	// 	yet, it'll do this itself.
+	if (pending.visible_step < dim)
+		return;
+	update_visible_faces();
+	if (begin_remesh())
+		update_quads_by_dir(mesh());
+}
+
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::update_visible_faces()
+{
+	// This function updates the visible_rows array and should
+	// 	be called whenever the chunk's block data changes.
+
+	visible_rows.resize(6);
+	for (int z = 0; z < dim; ++z)
+		update_visible_layer(z);
+}
+
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::update_visible_layer(int z)
+{
+	for (int y = 0; y < dim; ++y)
+		update_visible_row(y, z);
+}
+
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::update_visible_row(int y, int z)
+{
+	// A face is visible where its block is solid and the block it touches
+	// 	isn't. For ±X that block is the next bit over in the same row, and
+	// 	for ±Y/±Z it's the same bit of the neighbouring row, so each face
+	// 	direction of the whole row is one shift/AND.
+	const padded_row_t row = padded_solid[padded_row(y, z)];
+	const padded_row_t uncovered[6] = {
+		row & ~(row << 1),
+		row & ~(row >> 1),
+		row & ~padded_solid[padded_row(y - 1, z)],
+		row & ~padded_solid[padded_row(y + 1, z)],
+		row & ~padded_solid[padded_row(y, z - 1)],
+		row & ~padded_solid[padded_row(y, z + 1)],
+	};
+
+	// Drop the halo bits on the way out
+	for (int face = 0; face < 6; ++face)
+		visible_rows[face][y + z * dim] = visible_row_t(uncovered[face] >> 1);
+}
+
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::set_greed_limit(int limit)
+{
+	if (limit > dim)
+		limit = dim;
 	if (limit < 1)
 		limit = 1;
 	if (greed_limit == limit)
 		return;
 	greed_limit = limit;
-	update_iverts_by_dir();
+	select_mesh();
 }
 
-void CubicChunk::enable_textures()
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::enable_textures()
 {
 	if (using_textures)
 		return;
 	using_textures = true;
-	update_iverts_by_dir();
+	select_mesh();
 }
 
-void CubicChunk::disable_textures()
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::disable_textures()
 {
 	if (!using_textures)
 		return;
 	using_textures = false;
-	update_iverts_by_dir();
+	select_mesh();
+}
+
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::set_lod(bool textured, int limit)
+{
+	if (limit > dim)
+		limit = dim;
+	if (limit < 1)
+		limit = 1;
+	if (using_textures == textured && greed_limit == limit)
+		return;
+	using_textures = textured;
+	greed_limit = limit;
+	select_mesh();
+}
+
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::set_mesher(Mesher m)
+{
+	if (mesher == m)
+		return;
+	mesher = m;
+	select_mesh();
+}
+
+template <int chunk_dim>
+unsigned int BasicCubicChunk<chunk_dim>::ChunkMesh::memory_usage() const
+{
+	unsigned int bytes = sizeof(ChunkMesh);
+	for (const std::vector<PackedQuad>& quads : quads_by_dir)
+		bytes += quads.capacity() * sizeof(PackedQuad);
+	return bytes;
+}
+
+template <int chunk_dim>
+bool BasicCubicChunk<chunk_dim>::ChunkMesh::empty() const
+{
+	for (const std::vector<PackedQuad>& quads : quads_by_dir)
+		if (!quads.empty())
+			return false;
+	return true;
+}
+
+template <int chunk_dim>
+unsigned int BasicCubicChunk<chunk_dim>::get_mesh_cache_bytes() const
+{
+	unsigned int bytes = 0;
+	for (const ChunkMesh& cached : meshes)
+		bytes += cached.memory_usage();
+	return bytes;
+}
+
+template <int chunk_dim>
+unsigned int BasicCubicChunk<chunk_dim>::memory_usage() const
+{
+	// blocks and metadata count themselves as well as what they allocate
+	unsigned int bytes = sizeof(*this) - sizeof(blocks) - sizeof(metadata);
+	bytes += get_block_bytes() + get_mesh_cache_bytes();
+	for (const std::vector<PackedQuad>& quads : pending.mesh.quads_by_dir)
+		bytes += quads.capacity() * sizeof(PackedQuad);
+	bytes += visible_rows.capacity() * sizeof(visible_rows[0]);
+	return bytes;
+}
+
+template <int chunk_dim>
+typename BasicCubicChunk<chunk_dim>::MeshSettings BasicCubicChunk<chunk_dim>::wanted_mesh_settings() const
+{
+	// Untextured quads have no UVs to overflow, so they can grow as far as
+	// 	the chunk allows and greed_limit doesn't change their mesh.
+	return MeshSettings{ using_textures, using_textures ? greed_limit : dim, mesher };
+}
+
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::select_mesh()
+{
+	// Makes the mesh for the current settings the front (rendered) mesh if
+	// 	we have it cached, or starts building it otherwise.
+	const MeshSettings wanted = wanted_mesh_settings();
+
+	for (auto it = meshes.begin(); it != meshes.end(); ++it)
+	{
+		if (it->settings == wanted)
+		{
+			meshes.splice(meshes.begin(), meshes, it);
+			++mesh_cache_hits;
+			pending.active = false;
+			return;
+		}
+	}
+
+	if (pending.active && pending.mesh.settings == wanted)
+		return;
+
+	++mesh_cache_misses;
+	start_pending_mesh(wanted);
 }
 
-GLFix CubicChunk::taxidist_to(VECTOR3 point)
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::start_pending_mesh(const MeshSettings& settings)
+{
+	// (Re)starts meshing from the first slice. If the chunk's visible_rows
+	// 	aren't built yet we carry on from wherever that got to.
+	pending.active = true;
+	pending.mesh_step = 0;
+	pending.mesh.settings = settings;
+	for (std::vector<PackedQuad>& quads : pending.mesh.quads_by_dir)
+		quads.clear();
+}
+
+template <int chunk_dim>
+bool BasicCubicChunk<chunk_dim>::advance_pending_mesh()
+{
+	// Does one step of the pending build: one z-layer of visible_rows,
+	// 	or one slice of one face direction (one whole direction for the scan
+	// 	mesher). Returns true when there's nothing left to do.
+
+	if (!pending.active)
+		return true;
+
+	if (pending.visible_step < dim)
+	{
+		// Uniform chunks with nothing exposed don't need visible_rows at all
+		if (visible_rows.empty() && !has_exposed_faces())
+		{
+			pending.visible_step = dim;
+		}
+		else
+		{
+			visible_rows.resize(6);
+			update_visible_layer(pending.visible_step++);
+			return false;
+		}
+	}
+
+	ChunkMesh& target = pending.mesh;
+	const bool scan = target.settings.mesher == Mesher::Scan;
+	const int mesh_steps = scan ? 6 : 6 * dim;
+
+	if (visible_rows.empty())
+	{
+		// No visible faces, so the mesh is empty and we're already done
+		for (auto& starts : target.slice_starts)
+			starts.fill(0);
+		pending.mesh_step = mesh_steps;
+	}
+
+	if (pending.mesh_step < mesh_steps)
+	{
+		if (scan)
+		{
+			mesh_face_scan(pending.mesh_step, target.settings, target.quads_by_dir[pending.mesh_step]);
+		}
+		else
+		{
+			const int face = pending.mesh_step / dim;
+			const int slot = pending.mesh_step % dim;
+			auto& quads = target.quads_by_dir[face];
+			target.slice_starts[face][slot] = quads.size();
+			mesh_slice(face, slice_slot(face, slot), target.settings, quads);
+			if (slot == dim - 1)
+				target.slice_starts[face][dim] = quads.size();
+		}
+		++pending.mesh_step;
+		if (pending.mesh_step < mesh_steps)
+			return false;
+	}
+
+	// The new mesh is complete, so it replaces the front mesh
+	for (std::vector<PackedQuad>& quads : target.quads_by_dir)
+		quads.shrink_to_fit();
+	meshes.push_front(std::move(target));
+	pending.active = false;
+
+	// Evict the least recently used meshes until we're back under budget.
+	// 	We always keep the mesh we just built, even if it's over budget.
+	unsigned int bytes = get_mesh_cache_bytes();
+	while (meshes.size() > 1 &&
+		(meshes.size() > max_cached_meshes || bytes > max_cached_mesh_bytes))
+	{
+		bytes -= meshes.back().memory_usage();
+		meshes.pop_back();
+	}
+	return true;
+}
+
+template <int chunk_dim>
+bool BasicCubicChunk<chunk_dim>::advance_mesh_steps(int steps)
+{
+	for (int i = 0; i < steps; ++i)
+	{
+		if (advance_pending_mesh())
+			return true;
+	}
+	return !pending.active;
+}
+
+template <int chunk_dim>
+bool BasicCubicChunk<chunk_dim>::advance_mesh_for(unsigned int budget_us, Stopwatch& stopwatch)
+{
+	// Keeps stepping until the budget is used up. We always take at least
+	// 	one step so that a tiny budget can't stall meshing forever.
+	const double start_ms = stopwatch.get_ms();
+	do
+	{
+		if (advance_pending_mesh())
+			return true;
+	} while ((stopwatch.get_ms() - start_ms) * 1000 < budget_us);
+	return false;
+}
+
+template <int chunk_dim>
+GLFix BasicCubicChunk<chunk_dim>::taxidist_to(VECTOR3 point)
 {
 	VECTOR3 center = pos + VECTOR3{ dim / 2, dim / 2, dim / 2 };
 	return (center.x - point.x).abs() + (center.y - point.y).abs() + (center.z - point.z).abs();
 }
 
-void CubicChunk::update_iverts_by_dir()
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::update_quads_by_dir(ChunkMesh& target) const
 {
-	// This function uses the textures_by_dir arrays to update the iverts_by_dir vectors.
-	// 	Each element in the iverts_by_dir array is a vector of IndexedVertex structs.
+	// This function uses the visible_rows arrays to update the quads_by_dir vectors.
+	// 	Each element in the quads_by_dir array is a vector of PackedQuads.
 
 	for (int face = 0; face < 6; ++face)
 	{
-		const auto& textures = textures_by_dir[face];
-		auto& iverts = iverts_by_dir[face];
-		iverts.clear();
+		auto& quads = target.quads_by_dir[face];
+		auto& starts = target.slice_starts[face];
+		quads.clear();
 
-		// face is a number from 0 to 5, representing which face of the block
-		// 	we're working with. To combine textures and reduce the vertex count,
-		//  we're trying to find adjacent faces with the same texture. However, since
-		// 	different faces face different directions, we need to take this into account.
+		if (target.settings.mesher == Mesher::Scan)
+		{
+			mesh_face_scan(face, target.settings, quads);
+			continue;
+		}
 
-		// Given any coordinate `c` and its face:
-		//	the block `c + w_dir`'s face will be to its right
-		//	the block `c + h_dir`'s face will be to its bottom (since top-left is (0, 0))
-		VECTOR3 w_dir = face_u_orthos[face];
-		VECTOR3 h_dir = face_v_orthos[face];
+		for (int slot = 0; slot < dim; ++slot)
+		{
+			starts[slot] = quads.size();
+			mesh_slice(face, slice_slot(face, slot), target.settings, quads);
+		}
+		starts[dim] = quads.size();
+	}
+}
 
-		std::array<bool, size> ignore_mask;
-		ignore_mask.fill(false);
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::update_slice_quads(ChunkMesh& target, int face, int slice) const
+{
+	// Re-meshes a single slice and splices its quads into quads_by_dir[face]
+	// 	in place of the old ones. The quads of every later slice move by the
+	// 	difference, so we shift their starts too.
+
+	static std::vector<PackedQuad> slice_quads;
+	slice_quads.clear();
+	mesh_slice(face, slice, target.settings, slice_quads);
+
+	auto& quads = target.quads_by_dir[face];
+	auto& starts = target.slice_starts[face];
+	const int slot = slice_slot(face, slice);
+	const unsigned int old_begin = starts[slot];
+	const unsigned int old_end = starts[slot + 1];
+	const int delta = int(slice_quads.size()) - int(old_end - old_begin);
+
+	quads.erase(quads.begin() + old_begin, quads.begin() + old_end);
+	quads.insert(quads.begin() + old_begin, slice_quads.begin(), slice_quads.end());
+
+	for (int s = slot + 1; s <= dim; ++s)
+		starts[s] += delta;
+}
 
-		// Iterate through all blocks in the chunk
-		for (int idx = 0; idx < size; ++idx)
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::mesh_face_scan(int face, const MeshSettings& settings,
+	std::vector<PackedQuad>& quads) const
+{
+	// This is the original greedy mesher. It walks every block in the chunk
+	// 	and tries to grow a quad to the right and downwards from it.
+
+	// face is a number from 0 to 5, representing which face of the block
+	// 	we're working with. To combine textures and reduce the vertex count,
+	//  we're trying to find adjacent faces with the same texture. However, since
+	// 	different faces face different directions, we need to take this into account.
+
+	// Given any coordinate `c` and its face:
+	//	the block `c + w_dir`'s face will be to its right
+	//	the block `c + h_dir`'s face will be to its bottom (since top-left is (0, 0))
+	const ivec3 w_dir = face_u_orthos[face].widen();
+	const ivec3 h_dir = face_v_orthos[face].widen();
+
+	// On the heap, since at bigger chunk sizes it's too much for the stack
+	std::vector<bool> ignore_mask(size, false);
+
+	// Iterate through all blocks in the chunk
+	for (int idx = 0; idx < size; ++idx)
+	{
+		if (ignore_mask[idx])
+			continue;
+
+		ivec3 coords = coords_of_idx(idx);
+
+		int tex = visible_texture(face, coords);
+		if (tex == 0)
+			continue;
+		const int key = merge_key(tex, face, settings.textured);
+		const int limit = settings.limit;
+
+		// Currently our texture is only a 1x1 block. Let's see if we can
+		// combine it with any adjacent blocks to make a larger texture while
+		// reducing the vertex count
+		int ivert_w = 1;
+		int ivert_h = 1;
+
+		// Keep looking to the right of the current block.
+		// If we find a block with the same texture, we can combine that one
+		// 	to our current texture. (We then set the texture of that block to 0
+		// 	so we don't render it multiple times.)
+		// If the block doesn't exist, or if it has a different texture, we stop.
+
+		ivec3 adj_coords = coords + w_dir;
+		while (ivert_w < limit)
 		{
-			if (ignore_mask[idx])
-				continue;
+			if (!in_bounds(adj_coords))
+				break;
 
-			VECTOR3 coords = coords_of_idx(idx);
+			int next_idx = coords_to_idx(adj_coords);
 
-			int tex = textures[idx];
-			if (tex == 0)
-				continue;
+			int next_tex = visible_texture(face, adj_coords);
+			if (next_tex == 0 || merge_key(next_tex, face, settings.textured) != key)
+				break;
 
-			// Currently our texture is only a 1x1 block. Let's see if we can
-			// combine it with any adjacent blocks to make a larger texture while
-			// reducing the vertex count
-			int ivert_w = 1;
-			int ivert_h = 1;
+			ignore_mask[next_idx] = true;
+			++ivert_w;
+			adj_coords = adj_coords + w_dir;
+		}
 
-			// Keep looking to the right of the current block.
-			// If we find a block with the same texture, we can combine that one
-			// 	to our current texture. (We then set the texture of that block to 0
-			// 	so we don't render it multiple times.)
-			// If the block doesn't exist, or if it has a different texture, we stop.
+		// Begin by assuming that our ivert can have a height of `limit`
+		//	(this is optimal)
+		ivert_h = limit;
 
-			VECTOR3 adj_coords = coords + w_dir;
-			while (ivert_w < greed_limit)
+		// Iterate through columns of our current ivert
+		for (int u = 0; u < ivert_w; ++u)
+		{
+			for (int v = 1; v < ivert_h; ++v)
 			{
-				if (adj_coords.x < GLFix{ 0 } || adj_coords.x >= dim ||
-					adj_coords.y < GLFix{ 0 } || adj_coords.y >= dim ||
-					adj_coords.z < GLFix{ 0 } || adj_coords.z >= dim)
-					break;
+				// If we find in any column that ivert can't have our assumed
+				// 	height, update ivert_h accordingly
 
-				int next_idx = coords_to_idx({ adj_coords.x, adj_coords.y, adj_coords.z });
-				if (next_idx >= size)
+				adj_coords = coords + (w_dir * u) + (h_dir * v);
+				if (!in_bounds(adj_coords))
+				{
+					ivert_h = v;
 					break;
+				}
 
-				int next_tex = textures[next_idx];
-				if (next_tex != tex)
+				int next_tex = visible_texture(face, adj_coords);
+				if (next_tex == 0 || merge_key(next_tex, face, settings.textured) != key)
+				{
+					ivert_h = v;
 					break;
+				}
+			}
+		}
 
+		// Update the ignore_mask array accordingly so we don't render the same
+		// 	face multiple times. We've already done this for the top row so
+		// 	we're just doing it for the remaining ones
+		for (int u = 0; u < ivert_w; ++u)
+		{
+			for (int v = 1; v < ivert_h; ++v)
+			{
+				adj_coords = coords + (w_dir * u) + (h_dir * v);
+				int next_idx = coords_to_idx(adj_coords);
 				ignore_mask[next_idx] = true;
-				++ivert_w;
-				adj_coords = adj_coords + w_dir;
 			}
+		}
+
+		// Now that we know how big our texture is, we can add the indexed vertices
+		// 	to our quads vector :)
+		//  (the smiley face gets rid of all the bugs, trust me)
+		push_quads(quads, coords, tex, face, ivert_w, ivert_h, settings.textured);
+	}
+}
+
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::mesh_slice_bitmask(int face, int slice, const MeshSettings& settings,
+	std::vector<PackedQuad>& quads) const
+{
+	// A slice is the dim x dim layer of block faces of one direction that share
+	// 	the same coordinate along the face's normal. We lay it out so that
+	// 	row `b` holds the faces at v-coordinate b, and bit `a` of that row is
+	// 	the face at u-coordinate a (both counted along the positive axis).
+
+	using row_t = visible_row_t;
+
+	const FaceAxes& axes = face_axes[face];
+
+	std::array<row_t, dim> occupied;
+	std::array<std::array<int, dim>, dim> slice_textures;
+
+	int coords[3];
+	coords[axes.normal] = slice;
+	for (int b = 0; b < dim; ++b)
+	{
+		coords[axes.v] = b;
+		row_t row = 0;
+		for (int a = 0; a < dim; ++a)
+		{
+			coords[axes.u] = a;
+			int tex = visible_texture(face, { coords[0], coords[1], coords[2] });
+			slice_textures[b][a] = tex;
+			if (tex != 0)
+				row |= row_t(row_t(1) << a);
+		}
+		occupied[b] = row;
+	}
 
-			// Begin by assuming that our ivert can have a height of greed_limit
-			//	(this is optimal)
-			ivert_h = greed_limit;
+	// Mesh one merge key (texture, or colour when untextured) at a time. For
+	// 	each key we build the rows of faces using it, and then every merge
+	// 	test is just a mask AND.
+	const int limit = settings.limit;
+	for (int first_row = 0; first_row < dim; ++first_row)
+	{
+		while (occupied[first_row])
+		{
+			int tex = slice_textures[first_row][__builtin_ctz(occupied[first_row])];
+			const int key = merge_key(tex, face, settings.textured);
 
-			// Iterate through columns of our current ivert
-			for (int u = 0; u < ivert_w; ++u)
+			std::array<row_t, dim> rows;
+			rows.fill(0);
+			for (int b = first_row; b < dim; ++b)
 			{
-				for (int v = 1; v < ivert_h; ++v)
+				for (row_t bits = occupied[b]; bits; bits &= bits - 1)
 				{
-					// If we find in any column that ivert can't have our assumed
-					// 	height, update ivert_h accordingly
+					int a = __builtin_ctz(bits);
+					if (merge_key(slice_textures[b][a], face, settings.textured) == key)
+						rows[b] |= row_t(row_t(1) << a);
+				}
+				occupied[b] &= ~rows[b];
+			}
 
-					adj_coords = coords + (w_dir * u) + (h_dir * v);
-					if (adj_coords.x < GLFix{ 0 } || adj_coords.x >= dim ||
-						adj_coords.y < GLFix{ 0 } || adj_coords.y >= dim ||
-						adj_coords.z < GLFix{ 0 } || adj_coords.z >= dim)
+			for (int b = first_row; b < dim; ++b)
+			{
+				while (rows[b])
+				{
+					// The quad starts at the lowest set bit and runs as far as the
+					// 	bits stay set (see run_length())
+					int a = __builtin_ctz(rows[b]);
+					int ivert_w = run_length(rows[b], a);
+					if (ivert_w > limit)
+						ivert_w = limit;
+					row_t run = run_bits<row_t>(a, ivert_w);
+
+					// Grow downwards while the next row has the whole run set
+					int ivert_h = 1;
+					while (ivert_h < limit && b + ivert_h < dim &&
+						(rows[b + ivert_h] & run) == run)
 					{
-						ivert_h = v;
-						break;
+						rows[b + ivert_h] &= ~run;
+						++ivert_h;
 					}
+					rows[b] &= ~run;
+
+					// Quads grow along face_u_orthos/face_v_orthos, which can point
+					// 	towards the negative axis, so pick the corner that those
+					// 	vectors grow from
+					coords[axes.u] = axes.u_sign > 0 ? a : a + ivert_w - 1;
+					coords[axes.v] = axes.v_sign > 0 ? b : b + ivert_h - 1;
+					push_quads(quads, ivec3{ coords[0], coords[1], coords[2] },
+						tex, face, ivert_w, ivert_h, settings.textured);
+				}
+			}
+		}
+	}
+}
 
-					int next_idx = coords_to_idx({ adj_coords.x, adj_coords.y, adj_coords.z });
-					if (next_idx >= size)
-					{
-						ivert_h = v;
-						break;
-					}
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::mesh_slice(int face, int slice, const MeshSettings& settings,
+	std::vector<PackedQuad>& quads) const
+{
+	if (settings.mesher == Mesher::Specialised)
+		(this->*slice_kernels[face * 2 + settings.textured])(slice, settings.limit, quads);
+	else
+		mesh_slice_bitmask(face, slice, settings, quads);
+}
 
-					int next_tex = textures[next_idx];
-					if (next_tex != tex)
-					{
-						ivert_h = v;
-						break;
-					}
+template <int chunk_dim>
+template <int face, bool textured>
+void BasicCubicChunk<chunk_dim>::mesh_slice_kernel(int slice, int limit, std::vector<PackedQuad>& quads) const
+{
+	// The same algorithm as mesh_slice_bitmask(), but with the face direction
+	// 	and texture mode fixed at compile time. The axes and strides are all
+	// 	constants here, so the compiler can fold the index math down to adds
+	// 	and shifts, and there's no per-quad branching on the face or on
+	// 	textures.
+
+	using row_t = visible_row_t;
+	constexpr FaceAxes axes = face_axes[face];
+	constexpr int axis = face / 2;
+	constexpr int piece_size = textured ? Block::tex_repeat : dim;
+
+	// Which faces exist. For ±Y and ±Z faces u is x, so the rows of the
+	// 	slice are rows of visible_rows as they are. ±X slices are bit `slice`
+	// 	of every row, which we have to gather.
+	const auto& visible = visible_rows[face];
+	std::array<row_t, dim> occupied;
+	for (int b = 0; b < dim; ++b)
+	{
+		if constexpr (axes.normal == 0)
+		{
+			row_t row = 0;
+			for (int a = 0; a < dim; ++a)
+				row |= row_t((visible[b + a * dim] >> slice) & 1) << a;
+			occupied[b] = row;
+		}
+		else if constexpr (axes.normal == 1)
+			occupied[b] = visible[slice + b * dim];
+		else
+			occupied[b] = visible[b + slice * dim];
+	}
+
+	// The merge key (see merge_key()) of each visible face. Blocks are
+	// 	indexed by Layout::offset() of each axis added together.
+	std::array<int, dim> u_offsets;
+	for (int a = 0; a < dim; ++a)
+		u_offsets[a] = Layout::offset(axes.u, a);
+	// 	Untextured faces merge by colour, so there we also keep the texture
+	// 	to store in the quad.
+	std::array<std::array<int, dim>, dim> keys;
+	std::array<std::array<int, dim>, dim> textures;
+	for (int b = 0; b < dim; ++b)
+	{
+		const int row_idx = Layout::offset(axes.normal, slice) + Layout::offset(axes.v, b);
+		for (row_t bits = occupied[b]; bits; bits &= bits - 1)
+		{
+			const int a = __builtin_ctz(bits);
+			const int tex = blocks.get(row_idx + u_offsets[a]);
+			if constexpr (textured)
+			{
+				keys[b][a] = tex;
+			}
+			else
+			{
+				keys[b][a] = texdata_colorsheet[tex * 3 + axis];
+				textures[b][a] = tex;
+			}
+		}
+	}
+
+	for (int first_row = 0; first_row < dim; ++first_row)
+	{
+		while (occupied[first_row])
+		{
+			const int first = __builtin_ctz(occupied[first_row]);
+			const int key = keys[first_row][first];
+			const int tex = textured ? key : textures[first_row][first];
+
+			std::array<row_t, dim> rows;
+			rows.fill(0);
+			for (int b = first_row; b < dim; ++b)
+			{
+				for (row_t bits = occupied[b]; bits; bits &= bits - 1)
+				{
+					int a = __builtin_ctz(bits);
+					if (keys[b][a] == key)
+						rows[b] |= row_t(row_t(1) << a);
 				}
+				occupied[b] &= ~rows[b];
 			}
 
-			// Update the ignore_mask array accordingly so we don't render the same
-			// 	face multiple times. We've already done this for the top row so
-			// 	we're just doing it for the remaining ones
-			for (int u = 0; u < ivert_w; ++u)
+			for (int b = first_row; b < dim; ++b)
 			{
-				for (int v = 1; v < ivert_h; ++v)
+				while (rows[b])
 				{
-					adj_coords = coords + (w_dir * u) + (h_dir * v);
-					int next_idx = coords_to_idx({ adj_coords.x, adj_coords.y, adj_coords.z });
-					ignore_mask[next_idx] = true;
+					int a = __builtin_ctz(rows[b]);
+					int ivert_w = run_length(rows[b], a);
+					if (ivert_w > limit)
+						ivert_w = limit;
+					row_t run = run_bits<row_t>(a, ivert_w);
+
+					int ivert_h = 1;
+					while (ivert_h < limit && b + ivert_h < dim &&
+						(rows[b + ivert_h] & run) == run)
+					{
+						rows[b + ivert_h] &= ~run;
+						++ivert_h;
+					}
+					rows[b] &= ~run;
+
+					// Same tile-sized pieces as push_quads(), cut starting
+					// 	from the corner the quad grows from
+					for (int v0 = 0; v0 < ivert_h; v0 += piece_size)
+					{
+						const int ph = std::min(piece_size, ivert_h - v0);
+						const int pb = axes.v_sign > 0 ? b + v0 : b + ivert_h - v0 - ph;
+						for (int u0 = 0; u0 < ivert_w; u0 += piece_size)
+						{
+							const int pw = std::min(piece_size, ivert_w - u0);
+							const int pa = axes.u_sign > 0 ? a + u0 : a + ivert_w - u0 - pw;
+							quads.push_back(PackedQuad::make(slice, pa, pb, pw, ph, tex));
+						}
+					}
 				}
 			}
+		}
+	}
+}
 
-			// Now that we know how big our texture is, we can add the indexed vertices
-			// 	to our iverts vector :)
-			//  (the smiley face gets rid of all the bugs, trust me)
-			auto ivert_quad = get_ivert_quad(coords, tex, face, ivert_w, ivert_h);
-			for (const IndexedVertex& ivert : ivert_quad)
+template <int chunk_dim>
+const std::array<typename BasicCubicChunk<chunk_dim>::SliceKernel, 12> BasicCubicChunk<chunk_dim>::slice_kernels = {
+	&BasicCubicChunk::mesh_slice_kernel<0, false>, &BasicCubicChunk::mesh_slice_kernel<0, true>,
+	&BasicCubicChunk::mesh_slice_kernel<1, false>, &BasicCubicChunk::mesh_slice_kernel<1, true>,
+	&BasicCubicChunk::mesh_slice_kernel<2, false>, &BasicCubicChunk::mesh_slice_kernel<2, true>,
+	&BasicCubicChunk::mesh_slice_kernel<3, false>, &BasicCubicChunk::mesh_slice_kernel<3, true>,
+	&BasicCubicChunk::mesh_slice_kernel<4, false>, &BasicCubicChunk::mesh_slice_kernel<4, true>,
+	&BasicCubicChunk::mesh_slice_kernel<5, false>, &BasicCubicChunk::mesh_slice_kernel<5, true>,
+};
+
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::mark_covered_faces(int face, bool textured,
+	const std::vector<PackedQuad>& quads,
+	std::vector<int>& covered)
+{
+	// Marks which block faces a list of quads covers. Each covered face is
+	// 	marked with the quad's texture, or its colour when untextured.
+
+	const FaceAxes& axes = face_axes[face];
+	for (const PackedQuad& quad : quads)
+	{
+		const int mark = textured ? quad.tex() : texdata_colorsheet[quad.tex() * 3 + face / 2];
+
+		int coords[3];
+		coords[axes.normal] = quad.slice();
+		for (int b = quad.b(); b < quad.b() + quad.h(); ++b)
+		{
+			for (int a = quad.a(); a < quad.a() + quad.w(); ++a)
 			{
-				iverts.push_back(ivert);
+				coords[axes.u] = a;
+				coords[axes.v] = b;
+				covered[coords_to_idx({ coords[0], coords[1], coords[2] })] = mark;
 			}
 		}
 	}
 }
 
-void CubicChunk::set_block(int x, int y, int z, blocktype_t block_id)
+template <int chunk_dim>
+bool BasicCubicChunk<chunk_dim>::meshers_agree() const
 {
-	Block* block = block_at(x, y, z);
-	if (block == nullptr)
-		return;
-	block->set_type(block_id);
-	// update_occlusion_mask();
+	// One int per block is far too much for the stack at bigger chunk
+	// 	sizes, so these live on the heap and get reused for every face
+	std::vector<PackedQuad> quads;
+	std::vector<int> scan_covered(size);
+	std::vector<int> covered(size);
+
+	// This compares meshes of visible_rows, so it's only meaningful once
+	// 	the first pending build has got past updating those.
+	if (visible_rows.empty())
+		return true;
+	MeshSettings settings = wanted_mesh_settings();
+
+	for (int face = 0; face < 6; ++face)
+	{
+		quads.clear();
+		mesh_face_scan(face, settings, quads);
+		std::fill(scan_covered.begin(), scan_covered.end(), -1);
+		mark_covered_faces(face, settings.textured, quads, scan_covered);
+
+		for (Mesher m : { Mesher::Bitmask, Mesher::Specialised })
+		{
+			settings.mesher = m;
+			quads.clear();
+			for (int slice = 0; slice < dim; ++slice)
+				mesh_slice(face, slice, settings, quads);
+			std::fill(covered.begin(), covered.end(), -1);
+			mark_covered_faces(face, settings.textured, quads, covered);
+
+			if (covered != scan_covered)
+				return false;
+		}
+	}
+	return true;
 }
 
-int CubicChunk::render(VECTOR3 camera_pos, std::stringstream& ss, Stopwatch& stopwatch)
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::rebuild_mesh()
 {
-	// static std::map<VECTOR3, VECTOR3> projection_map;
-	// ss.str("");
-	ss << "::" << stopwatch.get_ms() << "\n";
+	meshes.clear();
+	++mesh_cache_misses;
+	start_pending_mesh(wanted_mesh_settings());
+}
 
-	/// PART 0: Easy Optimization
-	/// Use matrix multiplication to transform the corners of the chunk into screen coordinates.
-	/// If ALL of the corners are out of bounds, we don't need to render the chunk.
+template <int chunk_dim>
+bool BasicCubicChunk<chunk_dim>::begin_remesh()
+{
+	// Called after visible_rows changes. Returns true if the caller still
+	// 	has to update the changed slices of mesh().
 
-	auto& vi = xyz_to_vert_idx;
+	// A pending mesh may already have meshed the slices that changed,
+	// 	so it has to start over
+	if (pending.active)
+		start_pending_mesh(pending.mesh.settings);
 
-	int out_of_bounds = 0;
-	for (int i = 0; i < corners.size(); ++i)
+	if (meshes.empty())
+		return false;
+
+	// Our other cached meshes were built from the old blocks, so drop them
+	// 	and only keep the one we're rendering up to date
+	meshes.erase(std::next(meshes.begin()), meshes.end());
+
+	if (mesh().settings.mesher == Mesher::Scan)
 	{
-		VECTOR3 expanded_pos = (corners[i] + pos) * Block::block_size;
+		update_quads_by_dir(mesh());
+		return false;
+	}
+	return true;
+}
 
-		// VECTOR3& processed_pos = projection_map[corners[i]];
-		VECTOR3& processed_pos = projection_array[vi(corners[i].x, corners[i].y, corners[i].z)];
-		nglMultMatVectRes(transformation, &expanded_pos, &processed_pos);
-		if (processed_pos.z < GLFix{ 0 } ||
-			processed_pos.y / processed_pos.z > GLFix{ 1 } || processed_pos.y / processed_pos.z < GLFix{ -1 } ||
-			processed_pos.x / processed_pos.z > GLFix{ 1 } || processed_pos.x / processed_pos.z < GLFix{ -1 })
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::update_halo(int face, const BasicCubicChunk* neighbour, MissingNeighbour missing)
+{
+	const FaceAxes& axes = face_axes[face];
+	// Our border layer on this side, and the neighbour's layer that touches it
+	const int border = (face % 2 == 1) ? dim - 1 : 0;
+	const int neighbour_layer = dim - 1 - border;
+	const int halo = (face % 2 == 1) ? dim : -1;
+
+	bool changed = false;
+	for (int b = 0; b < dim; ++b)
+	{
+		for (int a = 0; a < dim; ++a)
 		{
-			++out_of_bounds;
+			int coords[3];
+			coords[axes.u] = a;
+			coords[axes.v] = b;
+
+			bool solid = (missing == MissingNeighbour::Solid);
+			if (neighbour != nullptr)
+			{
+				coords[axes.normal] = neighbour_layer;
+				solid = neighbour->blocks.get(coords_to_idx({ coords[0], coords[1], coords[2] })) != 0;
+			}
+
+			coords[axes.normal] = halo;
+			changed |= set_padded_solid(coords[0], coords[1], coords[2], solid);
 		}
 	}
-	if (out_of_bounds == corners.size())
-		return 0;
 
-	ss << "0:" << stopwatch.get_ms() << "\n";
+	if (!changed)
+		return;
 
+	if (visible_rows.empty())
+	{
+		if (has_exposed_faces())
+			expose_faces();
+		return;
+	}
 
-	/// PART 1: Transforming Position Vectors (v_*) into Projection Vectors (p_*)
-	///		AKA getting screen coordinates of vectors.
-	/// 	We do lots of linear interpolation here so not everything is 100%
-	///		accurate, but this seems to give us a >100% speedup, so we'll take it
+	// Only our border layer's faces on this side can have changed. For ±X
+	// 	that's a bit of every row, otherwise it's one row per z or y.
+	for (int i = 0; i < dim; ++i)
+	{
+		if (axes.normal == 0)
+			update_visible_layer(i);
+		else if (axes.normal == 1)
+			update_visible_row(border, i);
+		else
+			update_visible_row(i, border);
+	}
+
+	if (begin_remesh())
+		update_slice_quads(mesh(), face, border);
+}
 
-	for (int i = 0; i < corners.size(); i += 2)
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::set_block(int x, int y, int z, blocktype_t block_id)
+{
+	if (!in_bounds({ x, y, z }) || block_at(x, y, z) == block_id)
+		return;
+	blocks.set(coords_to_idx({ x, y, z }), block_id);
+	metadata.erase(coords_to_idx({ x, y, z }));
+
+	// Only the changed block's own faces and the one face of each neighbour
+	// 	that touches it can change visibility, and those are all in its own
+	// 	row or the four rows next to it. (If it only changed type, nothing's
+	// 	visibility changed, but its slices still need remeshing.)
+	const int coords[3] = { x, y, z };
+	const bool solidity_changed = set_padded_solid(x, y, z, block_id != 0);
+
+	// This was a uniform chunk we never built visible_rows for
+	if (visible_rows.empty())
 	{
-		// start and end will be the same except for the x-coordinate here.
-		// v_start will be [0, y, z]
-		// v_end will be [dim, y, z]
-		const VECTOR3& v_start = corners[i];
-		const VECTOR3& v_end = corners[i + 1];
+		if (has_exposed_faces())
+			expose_faces();
+		return;
+	}
 
-		// const VECTOR3& p_start = projection_map[v_start];
-		// const VECTOR3& p_end = projection_map[v_end];
+	if (solidity_changed)
+	{
+		update_visible_row(y, z);
+		if (y > 0)			update_visible_row(y - 1, z);
+		if (y < dim - 1)	update_visible_row(y + 1, z);
+		if (z > 0)			update_visible_row(y, z - 1);
+		if (z < dim - 1)	update_visible_row(y, z + 1);
+	}
 
-		const VECTOR3& p_start = projection_array[vi(v_start.x, v_start.y, v_start.z)];
-		const VECTOR3& p_end = projection_array[vi(v_end.x, v_end.y, v_end.z)];
+	if (!begin_remesh())
+		return;
 
-		const VECTOR3 p_delta = (p_end - p_start) / dim;
+	// For each direction that is the block's own slice, plus the slice of the
+	// 	neighbour whose face points back at the block (one step against the
+	// 	face's normal, e.g. x + 1 for -X faces)
+	for (int face = 0; face < 6; ++face)
+	{
+		const int slice = coords[face_axes[face].normal];
+		update_slice_quads(mesh(), face, slice);
 
-		// We already have position values for [0, y, z] and [dim, y, z] so
-		// now we linearly interpolate all the integral coordinates between
-		// [1, y, z] to [dim - 1, y, z]
-		for (int x = 1; x < dim; ++x)
-		{
-			VECTOR3 p = p_start + p_delta * x;
-			VECTOR3 v = { x, v_start.y, v_start.z };
-			// projection_map[v] = p;
-			projection_array[vi(v.x, v.y, v.z)] = p;
-		}
+		const int adj_slice = slice + ((face % 2 == 1) ? -1 : 1);
+		if (adj_slice >= 0 && adj_slice < dim)
+			update_slice_quads(mesh(), face, adj_slice);
 	}
+}
 
-	// Now projection_map contains all screen coordinates [x, y, z] where:
-	// 		0 <= x <= dim; 		y == 0 || y == dim; 		z == 0 || z == dim;
-
-	// Now we do the same thing for y.
-	for (int i = 0; i < corners.size(); i += 4)
+template <int chunk_dim>
+typename BasicCubicChunk<chunk_dim>::Lattice BasicCubicChunk<chunk_dim>::project_lattice() const
+{
+	// Corners 1, 2 and 4 are the ones along the x, y and z axes
+	std::array<VECTOR3, 8> corner_pos;
+	for (int i : { 0, 1, 2, 4 })
 	{
-		// start and end will be the same except for the y-coordinate here.
-		// v_start will be [x, 0, z]
-		// v_end will be [x, dim, z]
-		const VECTOR3& v_start = corners[i];
-		const VECTOR3& v_end = corners[i + 2];
+		VECTOR3 expanded_pos = (corners[i] + pos) * Block::block_size;
+		nglMultMatVectRes(transformation, &expanded_pos, &corner_pos[i]);
+	}
+	return Lattice{
+		corner_pos[0],
+		{ { corner_pos[1] - corner_pos[0], corner_pos[2] - corner_pos[0], corner_pos[4] - corner_pos[0] } } };
+}
 
-		// Iterate through all x-values from 0 to dim (including dim!)
-		for (int x = 0; x <= dim; ++x)
-		{
-			// const VECTOR3& p_start = projection_map[VECTOR3{x, v_start.y, v_start.z}];
-			// const VECTOR3& p_end = projection_map[VECTOR3{x, v_end.y, v_end.z}];
+template <int chunk_dim>
+std::array<GLFix, 3> BasicCubicChunk<chunk_dim>::camera_coords_of(VECTOR3 camera_pos) const
+{
+	// The camera's position in block units relative to the chunk
+	const VECTOR3 camera_local = camera_pos / Block::block_size - pos;
+	return { camera_local.x, camera_local.y, camera_local.z };
+}
 
-			const VECTOR3& p_start = projection_array[vi(x, v_start.y, v_start.z)];
-			const VECTOR3& p_end = projection_array[vi(x, v_end.y, v_end.z)];
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::add_occluders(OcclusionBuffer& buffer, VECTOR3 camera_pos) const
+{
+	if (meshes.empty() || mesh().empty() || containment == Frustum::Containment::Outside)
+		return;
+
+	// Textures with see-through pixels don't hide what's behind them
+	const TEXTURE* texture = nglGetTexture();
+	if (mesh().settings.textured && texture != nullptr && texture->has_transparency)
+		return;
 
-			const VECTOR3 p_delta = (p_end - p_start) / dim;
+	const Lattice lattice = project_lattice();
+	const std::array<GLFix, 3> camera_coords = camera_coords_of(camera_pos);
+	for (int dir = 0; dir < 6; ++dir)
+	{
+		const std::vector<PackedQuad>& quads = mesh().quads_by_dir[dir];
+		const FaceAxes& axes = face_axes[dir];
+		for (unsigned int i = first_visible_quad(dir, camera_coords); i < quads.size(); ++i)
+		{
+			const PackedQuad quad = quads[i];
+			if (quad.w() * quad.h() < min_occluder_area)
+				continue;
 
-			// We already have position values for [x, 0, z] and [x, dim, z] so
-			// now we linearly interpolate all the integral coordinates between
-			// [x, 1, z] to [x, dim - 1, z]
-			for (int y = 1; y < dim; ++y)
+			// Corners in order around the quad, unlike the draw order
+			// 	project_quad_corners() uses
+			static constexpr int around[4] = { 0, 1, 3, 2 };
+			std::array<VECTOR3, 4> corners_around;
+			int coords[3];
+			coords[axes.normal] = quad.slice() + dir % 2;
+			for (int j = 0; j < 4; ++j)
 			{
-				VECTOR3 p = p_start + p_delta * y;
-				VECTOR3 v = { x, y, v_start.z };
-				// projection_map[v] = p;
-				projection_array[vi(v.x, v.y, v.z)] = p;
+				coords[axes.u] = quad.a() + ((around[j] & 1) ? quad.w() : 0);
+				coords[axes.v] = quad.b() + ((around[j] & 2) ? quad.h() : 0);
+				corners_around[j] = lattice.at(coords[0], coords[1], coords[2]);
 			}
+			buffer.add_occluder(corners_around);
 		}
 	}
+}
 
-	// Now projection_map contains all screen coordinates [x, y, z] where:
-	// 		0 <= x <= dim; 		0 <= y <= dim; 		z == 0 || z == dim;
+template <int chunk_dim>
+unsigned int BasicCubicChunk<chunk_dim>::first_visible_quad(int dir,
+	const std::array<GLFix, 3>& camera_coords) const
+{
+	// The index of the first quad of mesh().quads_by_dir[dir] that can face
+	// 	the camera. Quads are sorted by slot, so everything from there on
+	// 	is in front of it, nearest first.
+	const GLFix cam = camera_coords[face_axes[dir].normal];
+
+	// Find the first slot whose slice faces the camera. A -X face of slice
+	// 	s lies on the plane x = s and faces us if we're below it, and a +X
+	// 	face lies on x = s + 1 and faces us if we're above it.
+	int first_slot;
+	if (dir % 2 == 0)
+		first_slot = fix_floor(cam) + 1;				// s > cam
+	else
+		first_slot = dim - 1 - (fix_ceil(cam) - 2);	// s < cam - 1
+	if (first_slot < 0)
+		first_slot = 0;
+	if (first_slot > dim)
+		first_slot = dim;
+
+	// The scan mesher's quads aren't sorted by slice, so all we can do
+	// 	is skip the whole direction
+	if (mesh().settings.mesher == Mesher::Scan)
+		return first_slot == dim ? mesh().quads_by_dir[dir].size() : 0;
+	return mesh().slice_starts[dir][first_slot];
+}
 
-	// Now all that's left is the z-values.
+template <int chunk_dim>
+void BasicCubicChunk<chunk_dim>::project_quad_corners(const Lattice& lattice, RenderScratch& scratch,
+	int face, const PackedQuad* quads, int count)
+{
+	// Queues the lattice points at the corners of the quads for projection
+	// 	into scratch.processed, skipping the ones another quad already did.
+	// 	nglDrawArray() works out the perspective from there, once per point
+	// 	per frame. The caller flushes whatever is left in the queue.
+	const FaceAxes& axes = face_axes[face];
+	for (int i = 0; i < count; ++i)
 	{
-		// start and end will be the same except for the z-coordinate here.
-		// v_start will be [x, y, 0]
-		// v_end will be [x, y, dim]
-		const VECTOR3& v_start = corners[0];
-		const VECTOR3& v_end = corners[4];
-
-		// Iterate through all x-values from 0 to dim (including dim!)
-		for (int x = 0; x <= dim; ++x)
+		const PackedQuad quad = quads[i];
+		int coords[3];
+		// Faces of + directions lie on the far side of their block
+		coords[axes.normal] = quad.slice() + face % 2;
+		for (int corner = 0; corner < 4; ++corner)
 		{
-			// Iterate through all y-values from 0 to dim (including dim!)
-			for (int y = 0; y <= dim; ++y)
-			{
-				// const VECTOR3& p_start = projection_map[VECTOR3{x, y, v_start.z}];
-				// const VECTOR3& p_end = projection_map[VECTOR3{x, y, v_end.z}];
-				const VECTOR3& p_start = projection_array[vi(x, y, v_start.z)];
-				const VECTOR3& p_end = projection_array[vi(x, y, v_end.z)];
-
-				const VECTOR3 p_delta = (p_end - p_start) / dim;
-
-				// We already have position values for [x, y, 0] and [x, y, dim] so
-				// now we linearly interpolate all the integral coordinates between
-				// [x, y, 1] to [x, y, dim - 1]
-				for (int z = 1; z < dim; ++z)
-				{
-					VECTOR3 p = p_start + p_delta * z;
-					VECTOR3 v = { x, y, z };
-					// projection_map[v] = p;
-					projection_array[vi(v.x, v.y, v.z)] = p;
-				}
-			}
+			coords[axes.u] = quad.a() + ((corner & 1) ? quad.w() : 0);
+			coords[axes.v] = quad.b() + ((corner & 2) ? quad.h() : 0);
+			const unsigned int idx = xyz_to_vert_idx(coords[0], coords[1], coords[2]);
+			if (scratch.projection_stamps[idx] == scratch.projection_stamp)
+				continue;
+			scratch.projection_stamps[idx] = scratch.projection_stamp;
+			scratch.queue_point(lattice, coords[0], coords[1], coords[2], idx);
+			++render_stats.points_projected;
 		}
 	}
+}
 
-	// Now projection_map contains all screen coordinates [x, y, z] where:
-	// 		0 <= x <= dim; 		0 <= y <= dim; 		0 <= z <= dim;
-	// This should be (dim + 1)^3 vertices
+template <int chunk_dim>
+int BasicCubicChunk<chunk_dim>::render(VECTOR3 camera_pos, RenderScratch& scratch, std::stringstream& ss, Stopwatch& stopwatch)
+{
+	// static std::map<VECTOR3, VECTOR3> projection_map;
+	// ss.str("");
+	ss << "::" << stopwatch.get_ms() << "\n";
+	render_stats = RenderStats{};
 
-	// debug << "Processed " << projection_map.size() << " vertices:\n";
+	// Nothing to draw until our first mesh has been built, or if it has no
+	// 	quads at all (e.g. a uniform chunk with no exposed faces)
+	if (meshes.empty() || mesh().empty())
+		return 0;
 
-	// // Print debug info
-	// for (auto& [v, p] : projection_map)
-	// {
-	// 	debug << "[" << (int)v.x << " " << (int)v.y << " " << (int)v.z << "]->["
-	// 	   << (int)p.x << " " << (int)p.y << " " << (int)p.z << "\n";
-	// }
+	/// PART 0: Easy Optimization
+	/// BasicChunkGrid::cull() already tested the chunk's box against the view
+	///		frustum. If it's outside, we don't need to render the chunk.
+	/// Otherwise use matrix multiplication to transform the origin and the
+	///		corner along each axis; that's all the LatticeProjection needs.
+	///		Then the same for the occlusion buffer, if there is one.
 
-	// ss << stopwatch.get_ms() << "\n";
+	if (containment == Frustum::Containment::Outside)
+	{
+		render_stats.culled = true;
+		return 0;
+	}
 
-	// for (auto& [c, p] : projection_map)
-	// {
-	// 	positions.push_back(c);
-	// 	processed.push_back(ProcessedPosition{p, {0, 0, 0}, false});
-	// }
+	const Lattice lattice = project_lattice();
 
-	ss << "1:" << stopwatch.get_ms() << "\n";
+	// Chunks hidden behind nearer terrain would lose every depth test, so
+	// 	we skip them before projecting anything else
+	if (scratch.occlusion != nullptr)
+	{
+		const double occlusion_start_ms = stopwatch.get_ms();
+		std::array<VECTOR3, 8> box;
+		for (int i = 0; i < 8; ++i)
+			box[i] = lattice.at((i & 1) ? dim : 0, (i & 2) ? dim : 0, (i & 4) ? dim : 0);
+		render_stats.occluded = scratch.occlusion->occludes(box);
+		render_stats.occlusion_ms = stopwatch.get_ms() - occlusion_start_ms;
+		if (render_stats.occluded)
+			return 0;
+	}
 
+	ss << "0:" << stopwatch.get_ms() << "\n";
 
-	/// PART 2: Format our positions and processed positions for the nglDrawArray function call
-	///
-	/// To use the nglDrawArray function, we need the following parameters:
-	/// 	indices: An array of IndexedVertex structs ( {index, u, v, c} )
-	/// 	positions: will be ignored since we've already processed the positions
-	/// 	processed: stores the processed positions. typically the nglDrawArray function
-	/// 		processes the positions for you, but since we've already done that, we
-	///		just pass in an array of already-processed positions and then pass
-	///		false into the function's 'reset_processed' param
 
-	// todo: optimize! this is no longer necessary now that i'm using an array instead of a map
-	// edit: somehow this is actually FASTER than just iterating through the projection array
-	// 	(i have no idea why, but we're keeping this i guess)
-	positions.clear();
-	processed.clear();
-	for (int z = 0; z < dim + 1; ++z)
+	/// PART 1: Transforming Position Vectors (v_*) into Projection Vectors (p_*)
+	///		AKA getting screen coordinates of vectors.
+	///		The transformation is affine until the perspective divide (which
+	///			nglDrawArray() does), so the corners give us every lattice point
+	///			exactly (see LatticeProjection). We only project the points that
+	///			the quads we're about to draw use, which for a greedy mesh is a
+	///			small fraction of all (dim + 1)^3 of them.
+
+	const std::array<GLFix, 3> camera_coords = camera_coords_of(camera_pos);
+
+	scratch.begin_chunk(lattice_points);
+
+	std::array<unsigned int, 6> begins;
+	for (int dir = 0; dir < 6; ++dir)
 	{
-		for (int y = 0; y < dim + 1; ++y)
-		{
-			for (int x = 0; x < dim + 1; ++x)
-			{
-				const VECTOR3 p = { x, y, z };
-				positions.push_back(p);
-				processed.push_back(ProcessedPosition{ projection_array[vi(p.x, p.y, p.z)], {0, 0, 0}, false });
-			}
-		}
+		const std::vector<PackedQuad>& quads = mesh().quads_by_dir[dir];
+		begins[dir] = first_visible_quad(dir, camera_coords);
+		project_quad_corners(lattice, scratch, dir, quads.data() + begins[dir], quads.size() - begins[dir]);
 	}
+	scratch.flush_points(lattice);
+
+	ss << "1:" << stopwatch.get_ms() << "\n";
+
 
 	// if (camera_pos != prev_camera_pos)
 	// {
@@ -554,38 +1458,38 @@ int CubicChunk::render(VECTOR3 camera_pos, std::stringstream& ss, Stopwatch& sto
 	// 	prev_camera_pos = camera_pos;
 	// }
 
-	ss << "2:" << stopwatch.get_ms() << "\n";
-
-
-	/// PART 3: Use all the data we have to make the `nglDrawArray` function call.
+	/// PART 2: Use all the data we have to make the `nglDrawArray` function call.
 	///		We'll be drawing up to six faces of vertices, since the camera
 	///			could be in the chunk we're drawing.
-	///		The iverts are already generated from the `update_iverts_by_dir` call.
+	///		The quads are already generated from the `update_quads_by_dir` call,
+	///			and we expand them into IndexedVertex a batch at a time.
+	///		Within each direction we only draw the slices in front of the camera,
+	///			nearest first, so that the z-buffer rejects more of what's behind.
 	///		When we're all done, we return the number of faces we drew
 
-	std::array<bool, 6> drawn_faces = {
-		(camera_pos.x / Block::block_size < pos.x + dim),
-		(camera_pos.x / Block::block_size > pos.x),
-		(camera_pos.y / Block::block_size < pos.y + dim),
-		(camera_pos.y / Block::block_size > pos.y),
-		(camera_pos.z / Block::block_size < pos.z + dim),
-		(camera_pos.z / Block::block_size > pos.z) };
-
 	const TEXTURE* texture = nglGetTexture();
-	if (!using_textures)
+	if (!mesh().settings.textured)
 		glBindTexture(nullptr);
 
 	int draw_count = 0;
 	for (int dir = 0; dir < 6; ++dir)
 	{
-		if (!drawn_faces[dir])
-			continue;
-		const std::vector<IndexedVertex>& iverts = iverts_by_dir[dir];
-		nglDrawArray(iverts.data(), iverts.size(),
-			positions.data(), positions.size(),
-			processed.data(), GL_QUADS,
-			false); // false for 'clear_processed' param bc we've already processed the positions
-		draw_count += iverts.size();
+		const std::vector<PackedQuad>& quads = mesh().quads_by_dir[dir];
+		const unsigned int begin = begins[dir];
+
+		const QuadExpander expand = quad_expanders[dir * 2 + mesh().settings.textured];
+		for (unsigned int first = begin; first < quads.size(); first += RenderScratch::batch_quads)
+		{
+			const int count = std::min<unsigned int>(RenderScratch::batch_quads, quads.size() - first);
+			expand(quads.data() + first, count, scratch.vertices.data());
+			draw_processed(scratch.vertices.data(), count * 4, scratch.processed.data(), lattice_points);
+			++render_stats.draw_calls;
+		}
+		draw_count += (quads.size() - begin) * 4;
+		render_stats.quads_drawn += quads.size() - begin;
+		if (containment == Frustum::Containment::Inside)
+			render_stats.quads_inside += quads.size() - begin;
+		render_stats.quads_skipped += begin;
 	}
 
 	// ss << stopwatch.get_ms() << "\n";
@@ -598,7 +1502,7 @@ int CubicChunk::render(VECTOR3 camera_pos, std::stringstream& ss, Stopwatch& sto
 	// ss << stopwatch.get_ms() << "\n";
 	glBindTexture(texture);
 
-	ss << "3:" << stopwatch.get_ms() << "\n";
+	ss << "2:" << stopwatch.get_ms() << "\n";
 
 	return draw_count;
 }
@@ -751,3 +1655,12 @@ int CubicChunk::_render_old(VECTOR3 camera_pos)
 }
 
 */
+
+// The chunk sizes benchmark_chunk_sizes() compares, and whatever size the
+// 	game is built with (see CHUNK_DIM)
+template class BasicCubicChunk<8>;
+template class BasicCubicChunk<16>;
+template class BasicCubicChunk<32>;
+#if CHUNK_DIM != 8 && CHUNK_DIM != 16 && CHUNK_DIM != 32
+template class BasicCubicChunk<CHUNK_DIM>;
+#endif
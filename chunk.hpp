@@ -2,84 +2,378 @@
 
 #pragma once
 
+#include <list>
+#include <type_traits>
 #include <vector>
 
 #include "nGL/gl.h"
 #include "nGL/gldrawarray.h"
 
 #include "block.hpp"
+#include "block_metadata.hpp"
+#include "block_palette.hpp"
+#include "block_layout.hpp"
+#include "frustum.hpp"
+#include "ivec3.hpp"
+#include "lattice_projection.hpp"
+#include "render_scratch.hpp"
 #include "timer.hpp"
 
-class CubicChunk
+// Side length of the chunks the game uses, see CHUNK_DIM in the Makefile
+#ifndef CHUNK_DIM
+#define CHUNK_DIM 16
+#endif
+
+// The parts of a chunk that are the same whatever its size
+class CubicChunkBase
+{
+public:
+	// Which greedy mesher update_quads_by_dir() uses.
+	//	Scan walks every block of the chunk once per face direction,
+	//	Bitmask works slice by slice on rows of visible faces packed into bitmasks,
+	//	Specialised is Bitmask compiled separately for each face direction
+	//		and texture mode.
+	enum class Mesher { Scan, Bitmask, Specialised };
+
+	// What update_halo() assumes is next to a side with no neighbouring
+	//	chunk. Air draws the faces at the edge of the world, Solid hides them
+	//	(cheaper, but you can see into the terrain from outside the world).
+	enum class MissingNeighbour { Air, Solid };
+
+	// What the last render() did, for the debug overlay and benchmarks
+	struct RenderStats
+	{
+		bool culled = false;			// the whole chunk was outside the frustum
+		unsigned int draw_calls = 0;	// nglDrawArray() calls
+		unsigned int quads_drawn = 0;
+		unsigned int quads_inside = 0;	// of quads_drawn, in a chunk entirely inside the frustum
+		unsigned int quads_skipped = 0;	// in slices facing away from the camera
+		unsigned int points_projected = 0;	// lattice points the drawn quads use
+		bool occluded = false;			// hidden behind the RenderScratch's occluders
+		double occlusion_ms = 0;		// spent finding out whether it was
+	};
+};
+
+// A dim x dim x dim block of the world. Every table and bitmask is sized
+//	from dim, so other sizes can be instantiated side by side (see
+//	benchmark_chunk_sizes()); chunk.cpp instantiates 8, 16 and 32.
+template <int chunk_dim>
+class BasicCubicChunk : public CubicChunkBase
 {
 public:
-	static constexpr int dim = 16;				 // side length
-	static constexpr int size = dim * dim * dim; // volume
+	static constexpr int dim = chunk_dim;			// side length
+	static constexpr int size = dim * dim * dim;	// volume
+	static_assert(dim <= 32, "rows of a chunk are stored as at most 32-bit masks");
+
+	// How blocks are ordered in memory. Everything that indexes blocks goes
+	//	through coords_to_idx()/coords_of_idx() or Layout::offset(), so this
+	//	is the only thing to change.
+#ifdef BLOCK_LAYOUT_MORTON
+	using Layout = MortonLayout<dim>;
+#else
+	using Layout = LinearLayout<dim>;
+#endif
 
 private:
 	// Basic chunk attributes.
 	// pos refers to the xyz coordinates of the block at
 	// the chunk's -X -Y -Z corner.
 	const VECTOR3 pos;
-	std::array<Block, size> blocks;
+	PalettedBlocks<size> blocks;
+	BlockMetadataTable metadata;	// only for the blocks that have any
+
+	// Which blocks are solid (not air), with a one block border (the halo)
+	//	around them holding the neighbouring chunks' blocks (see
+	//	update_halo()). Each entry is one x-row: bit x + 1 is the block at
+	//	x, for x in [-1, dim]. A block's ±X neighbours are the next bits
+	//	over and its ±Y/±Z neighbours are in the rows next to it, so face
+	//	culling needs no bounds checks. It also means faces on the chunk's
+	//	border are culled against the real blocks next to them.
+	static constexpr int padded_dim = dim + 2;
+	using padded_row_t = std::conditional_t<(padded_dim <= 32), uint32_t, uint64_t>;
+	std::array<padded_row_t, padded_dim * padded_dim> padded_solid;
+
+	// The bits of a padded row that are inside the chunk
+	static constexpr padded_row_t inner_bits = ((padded_row_t(1) << dim) - 1) << 1;
+
+	// Takes coordinates in [-1, dim]
+	static constexpr int padded_row(int y, int z)
+	{
+		return (y + 1) + (z + 1) * padded_dim;
+	}
+	bool set_padded_solid(int x, int y, int z, bool solid);
 
 	// Rendering implementation details
 	static const std::array<VECTOR3, 8> corners;
-	static const std::array<VECTOR3, 6> face_toplefts;
-	static const std::array<VECTOR3, 6> face_u_orthos;
-	static const std::array<VECTOR3, 6> face_v_orthos;
+	static const std::array<ivec3_s8, 6> face_u_orthos;
+	static const std::array<ivec3_s8, 6> face_v_orthos;
+	static const std::array<ivec3_s8, 6> face_normals;
+
+	// For each face direction, the axis (0=x, 1=y, 2=z) its normal points
+	//	along and the axes/signs of face_u_orthos and face_v_orthos.
+	//	The bitmask mesher uses these to lay a slice out as rows (v) of bits (u).
+	struct FaceAxes { int normal, u, v, u_sign, v_sign; };
+	static constexpr std::array<FaceAxes, 6> face_axes = { {
+		{ 0, 2, 1, -1, -1 }, { 0, 2, 1, 1, -1 },
+		{ 1, 0, 2, -1, -1 }, { 1, 0, 2, 1, -1 },
+		{ 2, 0, 1, 1, -1 }, { 2, 0, 1, -1, -1 } } };
 
 	// [[deprecated]] std::array<std::array<bool, 6>, size> occlusion_mask;
 	// [[deprecated]] std::vector<VERTEX> vertices;
 	// [[deprecated]] VECTOR3 prev_camera_pos;
 
-	std::array<VECTOR3, (dim + 1)* (dim + 1)* (dim + 1)> projection_array;
-
-	std::array<std::array<int, size>, 6> textures_by_dir;
-	std::array<std::vector<IndexedVertex>, 6> iverts_by_dir;
-
-	std::vector<IndexedVertex> indices;
-	std::vector<VECTOR3> positions;
-	std::vector<ProcessedPosition> processed;
+	// How many lattice points (block corners) the chunk has. render()
+	//	projects the ones it draws into a RenderScratch.
+	static constexpr unsigned int lattice_points = (dim + 1) * (dim + 1) * (dim + 1);
+
+	// See lattice_projection.hpp
+	using Lattice = LatticeProjection<dim>;
+
+	// Which faces of each direction aren't covered by another block.
+	//	visible_rows[face][y + z * dim] has bit x set if the face of the
+	//	block at (x, y, z) is visible. These are kept in this row layout
+	//	whatever Layout is, since they're built a row at a time. The texture
+	//	of a visible face is just its block's type (see visible_texture()).
+	//	Empty (rather than all zero) for uniform chunks with no exposed faces,
+	//	until an edit or a neighbour gives them some (see expose_faces()).
+	using visible_row_t = std::conditional_t<(dim <= 8), uint8_t,
+		std::conditional_t<(dim <= 16), uint16_t, uint32_t>>;
+	std::vector<std::array<visible_row_t, dim * dim>> visible_rows;
+
+	// The settings that change what mesh we build for the chunk
+	struct MeshSettings
+	{
+		bool textured;
+		int limit;		// greed limit, or dim for untextured meshes
+		Mesher mesher;
+
+		bool operator==(const MeshSettings& other) const
+		{
+			return textured == other.textured && limit == other.limit && mesher == other.mesher;
+		}
+	};
+
+	// One quad of a chunk mesh. Which quads_by_dir vector it's in gives its
+	//	face direction and the mesh's settings say whether it's textured, so
+	//	the rest is five coordinates of coord_bits each, then the block type
+	//	(any of the merged ones when untextured) in the bits above them.
+	//	For dim 16 that's 32 bits, a quarter of one IndexedVertex:
+	//		bits  0-3	a, its lowest u-coordinate (see FaceAxes)
+	//		bits  4-7	b, its lowest v-coordinate
+	//		bits  8-11	width - 1 (along u)
+	//		bits 12-15	height - 1 (along v)
+	//		bits 16-19	slice
+	//		bits 20-31	block type
+	//	Chunks too big to leave 12 bits for the type use 64 bits.
+	//	expand_quads() turns quads back into IndexedVertex just before drawing.
+	static constexpr int coord_bits = dim <= 8 ? 3 : dim <= 16 ? 4 : 5;
+	struct PackedQuad
+	{
+		using bits_t = std::conditional_t<(5 * coord_bits + 12 <= 32), uint32_t, uint64_t>;
+		static constexpr bits_t coord_mask = (1 << coord_bits) - 1;
+		bits_t bits;
+
+		static constexpr PackedQuad make(int slice, int a, int b, int w, int h, int tex)
+		{
+			return PackedQuad{ bits_t(a) | bits_t(b) << coord_bits |
+				bits_t(w - 1) << (2 * coord_bits) | bits_t(h - 1) << (3 * coord_bits) |
+				bits_t(slice) << (4 * coord_bits) | bits_t(tex) << (5 * coord_bits) };
+		}
+
+		constexpr int a() const { return bits & coord_mask; }
+		constexpr int b() const { return (bits >> coord_bits) & coord_mask; }
+		constexpr int w() const { return ((bits >> (2 * coord_bits)) & coord_mask) + 1; }
+		constexpr int h() const { return ((bits >> (3 * coord_bits)) & coord_mask) + 1; }
+		constexpr int slice() const { return (bits >> (4 * coord_bits)) & coord_mask; }
+		constexpr int tex() const { return bits >> (5 * coord_bits); }
+	};
+
+	// The mesh of the chunk for one MeshSettings
+	struct ChunkMesh
+	{
+		MeshSettings settings;
+
+		std::array<std::vector<PackedQuad>, 6> quads_by_dir;
+
+		// slice_starts[face][slot] is the index into quads_by_dir[face] where
+		//	the quads of the slice in that slot begin (and the previous slot's
+		//	quads end). See slice_slot() for how slices map to slots.
+		//	Only the Scan mesher doesn't emit its quads slice by slice, so these
+		//	are only valid when mesher != Mesher::Scan.
+		std::array<std::array<unsigned int, dim + 1>, 6> slice_starts;
+
+		unsigned int memory_usage() const;
+		bool empty() const;
+	};
+
+	// Meshes we've built for this chunk, most recently used first.
+	//	The front mesh is the one we render, so switching between cached
+	//	settings only relinks a list node.
+	std::list<ChunkMesh> meshes;
+	static constexpr unsigned int max_cached_meshes = 4;
+	static constexpr unsigned int max_cached_mesh_bytes = 64 * 1024;
+
+	unsigned int mesh_cache_hits = 0;
+	unsigned int mesh_cache_misses = 0;
+
+	// Slices are stored in the order the camera would see them from the side
+	//	the face points towards: ascending for -X/-Y/-Z faces and descending
+	//	for +X/+Y/+Z faces. Wherever the camera is, the slices facing it are
+	//	then a suffix of the storage, already sorted front-to-back.
+	//	(This mapping is its own inverse, so it also maps slots to slices.)
+	static constexpr int slice_slot(int face, int slice)
+	{
+		return face % 2 == 1 ? dim - 1 - slice : slice;
+	}
 
-	// Helper functions
-	static VECTOR3 coords_of_idx(int idx);
-	static int coords_to_idx(VECTOR3 coords);
+	ChunkMesh& mesh() { return meshes.front(); }
+	const ChunkMesh& mesh() const { return meshes.front(); }
 
-	Block* block_at(int x, int y, int z);
-	const Block* block_at(int x, int y, int z) const;
+	// A mesh that advance_mesh_steps()/advance_mesh_for() are building a
+	//	slice at a time. Until it's done, we keep rendering the front mesh.
+	//	The chunk's first build also runs update_visible_faces() one
+	//	z-layer per step before meshing.
+	struct PendingMesh
+	{
+		bool active = false;
+		int visible_step = dim;	// next z-layer of visible_rows to update
+		int mesh_step = 0;		// next (face, slot) or, for Scan, face to mesh
+		ChunkMesh mesh;
+	};
+	PendingMesh pending;
 
-	bool block_is_visible_from_side(int idx, int face);
+	MeshSettings wanted_mesh_settings() const;
+	void start_pending_mesh(const MeshSettings& settings);
+	bool advance_pending_mesh();
 
-	std::array<IndexedVertex, 4> get_ivert_quad(
-		VECTOR3 coords,
-		blocktype_t btype, int face,
-		int u, int v);
 
-	void update_textures_by_dir();
-	void update_iverts_by_dir();
+	// Helper functions
+	static constexpr ivec3 coords_of_idx(int idx) { return Layout::coords(idx); }
+	static constexpr int coords_to_idx(ivec3 coords)
+	{
+		return Layout::offset(0, coords.x) + Layout::offset(1, coords.y) + Layout::offset(2, coords.z);
+	}
+	static bool in_bounds(ivec3 coords);
+
+	blocktype_t block_at(int x, int y, int z) const;
+
+	int visible_texture(int face, ivec3 coords) const;
+
+	static int merge_key(int tex, int face, bool textured);
+	static void push_quads(std::vector<PackedQuad>& quads,
+		ivec3 coords, int tex, int face,
+		int u, int v, bool textured);
+
+	template <int face, bool textured>
+	static void expand_quads(const PackedQuad* quads, int count, IndexedVertex* out);
+
+	// expand_quads for every (face, textured), indexed like slice_kernels
+	using QuadExpander = void (*)(const PackedQuad*, int, IndexedVertex*);
+	static const std::array<QuadExpander, 12> quad_expanders;
+
+	Lattice project_lattice() const;
+	std::array<GLFix, 3> camera_coords_of(VECTOR3 camera_pos) const;
+	unsigned int first_visible_quad(int dir, const std::array<GLFix, 3>& camera_coords) const;
+	void project_quad_corners(const Lattice& lattice, RenderScratch& scratch,
+		int face, const PackedQuad* quads, int count);
+
+	bool has_exposed_faces() const;
+	void expose_faces();
+	void update_visible_faces();
+	void update_visible_layer(int z);
+	void update_visible_row(int y, int z);
+	bool begin_remesh();
+	void update_quads_by_dir(ChunkMesh& target) const;
+	void update_slice_quads(ChunkMesh& target, int face, int slice) const;
+	void select_mesh();
+
+	void mesh_face_scan(int face, const MeshSettings& settings,
+		std::vector<PackedQuad>& quads) const;
+	void mesh_slice_bitmask(int face, int slice, const MeshSettings& settings,
+		std::vector<PackedQuad>& quads) const;
+	void mesh_slice(int face, int slice, const MeshSettings& settings,
+		std::vector<PackedQuad>& quads) const;
+
+	template <int face, bool textured>
+	void mesh_slice_kernel(int slice, int limit, std::vector<PackedQuad>& quads) const;
+
+	// mesh_slice_kernel for every (face, textured), indexed by face * 2 + textured
+	using SliceKernel = void (BasicCubicChunk::*)(int, int, std::vector<PackedQuad>&) const;
+	static const std::array<SliceKernel, 12> slice_kernels;
+
+	static void mark_covered_faces(int face, bool textured,
+		const std::vector<PackedQuad>& quads,
+		std::vector<int>& covered);
 
 	// The limit of block sizes that we render with greedy meshes.
 	// For example, with greed_limit 2, we will combine 2x2 faces
 	// into a single quad.
 	//
-	// NOTE: greed_limit > 4 results in out-of-bounds memory access, and
-	//		so we don't allow it.
+	// NOTE: Textured quads larger than Block::tex_repeat would sample past
+	//		their texture in the spritesheet, so push_quads() splits
+	//		them into tex_repeat-sized pieces. greed_limit can be up to dim.
+	// NOTE: Untextured quads ignore greed_limit (see wanted_mesh_settings())
 	// NOTE: Never change this directly! Use set_greed_limit() instead
 	int greed_limit = 1;
 
 	bool using_textures = true;
 
+	Mesher mesher = Mesher::Specialised;
+
 	// [[deprecated]] void update_occlusion_mask();
 	// [[deprecated]] void update_vertices(VECTOR3 camera_pos);
 	// [[deprecated]] int _render_old(VECTOR3 camera_pos);
 
+	RenderStats render_stats;
+
+	// Set by BasicChunkGrid::cull() each frame
+	Frustum::Containment containment = Frustum::Containment::Intersecting;
+
 public:
-	CubicChunk(VECTOR3 pos);
+	BasicCubicChunk(VECTOR3 pos);
 
+	// Replacing a block also clears its metadata
 	void set_block(int x, int y, int z, blocktype_t block_id);
 
-	int render(VECTOR3 camera_pos, std::stringstream& ss, Stopwatch& stopwatch);
+	// Returns nullptr if the block has no metadata or isn't in the chunk.
+	//	Metadata doesn't change how a block is drawn, so setting it never
+	//	remeshes.
+	const BlockMetadata* metadata_at(int x, int y, int z) const;
+	void set_metadata(int x, int y, int z, const BlockMetadata& block_metadata);
+
+	// How many bytes the chunk's (palette compressed) block types and their
+	//	metadata take up. Unpacked, the types alone took size * sizeof(Block).
+	unsigned int get_block_bytes() const { return blocks.memory_usage() + metadata.memory_usage(); }
+	unsigned int get_metadata_count() const { return metadata.count(); }
+
+	// Whether every block in the chunk is the same type. Uniform chunks
+	//	that aren't next to anything they could show a face to skip
+	//	meshing and rendering entirely.
+	bool is_uniform() const { return blocks.is_uniform(); }
+
+	// Copies the layer of blocks of `neighbour` that touches our `face` side
+	//	into our halo (or fills it according to `missing` if neighbour is
+	//	nullptr), and remeshes that side if it changed. ChunkGrid calls this
+	//	whenever the neighbour changes a block on that layer.
+	void update_halo(int face, const BasicCubicChunk* neighbour,
+		MissingNeighbour missing = MissingNeighbour::Air);
+
+	// Draws the chunk's front mesh. scratch holds the per-draw buffers and
+	//	can be shared by every chunk. Chunks whose containment was last set
+	//	to Outside draw nothing.
+	int render(VECTOR3 camera_pos, RenderScratch& scratch, std::stringstream& ss, Stopwatch& stopwatch);
+	const RenderStats& get_render_stats() const { return render_stats; }
+
+	// Adds the chunk's quads that face the camera and cover at least
+	//	min_occluder_area blocks to buffer, for render() to test chunks
+	//	further away against. Meant for the few chunks nearest the camera.
+	static constexpr int min_occluder_area = 4;
+	void add_occluders(OcclusionBuffer& buffer, VECTOR3 camera_pos) const;
+
+	// Where the chunk is relative to the view frustum. Chunks that nobody
+	//	culls count as Intersecting, which draws them.
+	void set_containment(Frustum::Containment c) { containment = c; }
+	Frustum::Containment get_containment() const { return containment; }
 
 	void set_greed_limit(int limit);
 	int get_greed_limit() { return greed_limit; }
@@ -87,6 +381,36 @@ public:
 	void enable_textures();
 	void disable_textures();
 
+	// Changes both settings at once, so that we don't build (or cache) a
+	//	mesh for the in-between combination
+	void set_lod(bool textured, int limit);
+
+	void set_mesher(Mesher m);
+	Mesher get_mesher() { return mesher; }
+
+	unsigned int get_mesh_cache_hits() const { return mesh_cache_hits; }
+	unsigned int get_mesh_cache_misses() const { return mesh_cache_misses; }
+	unsigned int get_mesh_cache_bytes() const;
+
+	// Roughly everything the chunk has allocated: blocks, metadata and
+	//	cached meshes (render buffers live in the RenderScratch)
+	unsigned int memory_usage() const;
+
+	// Changing settings or blocks doesn't remesh right away. Instead the
+	//	main loop spreads the work over frames with these. Both return true
+	//	once there's nothing left to build.
+	bool advance_mesh_steps(int steps);
+	bool advance_mesh_for(unsigned int budget_us, Stopwatch& stopwatch);
+	bool mesh_pending() const { return pending.active; }
+
+	// Builds the mesh with every mesher and checks that they cover exactly
+	//	the same set of block faces with the same textures.
+	bool meshers_agree() const;
+
+	// Throws away every cached mesh and starts building the mesh for the
+	//	current settings again
+	void rebuild_mesh();
+
 	GLFix taxidist_to(VECTOR3 point);
 
 	// This is still public because Block uses it (deprecated code)
@@ -96,6 +420,9 @@ public:
 	}
 };
 
+// The chunk size the game uses
+using CubicChunk = BasicCubicChunk<CHUNK_DIM>;
+
 /*
 
 	To render our chunk, we need to know what vertices to render.
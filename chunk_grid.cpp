@@ -0,0 +1,184 @@
+// chunk_grid.cpp
+
+#include "chunk_grid.hpp"
+
+// Chunk offsets for each face direction, in the same order as faces
+static constexpr int face_steps[6][3] = {
+	{ -1, 0, 0 }, { 1, 0, 0 },
+	{ 0, -1, 0 }, { 0, 1, 0 },
+	{ 0, 0, -1 }, { 0, 0, 1 } };
+
+template <class Chunk>
+BasicChunkGrid<Chunk>::BasicChunkGrid(int size_x, int size_y, int size_z,
+	CubicChunkBase::MissingNeighbour missing_neighbours)
+	: size_x(size_x), size_y(size_y), size_z(size_z),
+	missing_neighbours(missing_neighbours)
+{
+	chunks.reserve(size_x * size_y * size_z);
+	for (int cz = 0; cz < size_z; ++cz)
+	{
+		for (int cy = 0; cy < size_y; ++cy)
+		{
+			for (int cx = 0; cx < size_x; ++cx)
+			{
+				chunks.emplace_back(VECTOR3{
+					cx * Chunk::dim,
+					cy * Chunk::dim,
+					cz * Chunk::dim });
+				chunk_created(cx, cy, cz);
+			}
+		}
+	}
+}
+
+template <class Chunk>
+Chunk* BasicChunkGrid<Chunk>::chunk_at(int cx, int cy, int cz)
+{
+	if (cx < 0 || cx >= size_x ||
+		cy < 0 || cy >= size_y ||
+		cz < 0 || cz >= size_z)
+		return nullptr;
+
+	// Chunks are created in order, so a later one may not exist yet
+	const unsigned int idx = cx + cy * size_x + cz * size_x * size_y;
+	if (idx >= chunks.size())
+		return nullptr;
+	return &chunks[idx];
+}
+
+template <class Chunk>
+void BasicChunkGrid<Chunk>::chunk_created(int cx, int cy, int cz)
+{
+	// The new chunk fills its halo from whichever neighbours exist, and
+	// 	each of those only has to look at the one side touching it
+	Chunk& chunk = *chunk_at(cx, cy, cz);
+	for (int face = 0; face < 6; ++face)
+	{
+		Chunk* neighbour = chunk_at(
+			cx + face_steps[face][0],
+			cy + face_steps[face][1],
+			cz + face_steps[face][2]);
+		chunk.update_halo(face, neighbour, missing_neighbours);
+		if (neighbour != nullptr)
+			neighbour->update_halo(face ^ 1, &chunk, missing_neighbours);
+	}
+}
+
+template <class Chunk>
+void BasicChunkGrid<Chunk>::set_block(int x, int y, int z, blocktype_t block_id)
+{
+	static constexpr int dim = Chunk::dim;
+	if (x < 0 || y < 0 || z < 0)
+		return;
+
+	const int cx = x / dim, cy = y / dim, cz = z / dim;
+	Chunk* chunk = chunk_at(cx, cy, cz);
+	if (chunk == nullptr)
+		return;
+
+	const int local[3] = { x % dim, y % dim, z % dim };
+	chunk->set_block(local[0], local[1], local[2], block_id);
+
+	// A block on the chunk's border is in the halo of the neighbour on
+	// 	that side
+	for (int face = 0; face < 6; ++face)
+	{
+		const int axis = face / 2;
+		if (local[axis] != ((face % 2 == 1) ? dim - 1 : 0))
+			continue;
+		Chunk* neighbour = chunk_at(
+			cx + face_steps[face][0],
+			cy + face_steps[face][1],
+			cz + face_steps[face][2]);
+		if (neighbour != nullptr)
+			neighbour->update_halo(face ^ 1, chunk, missing_neighbours);
+	}
+}
+
+template <class Chunk>
+const BlockMetadata* BasicChunkGrid<Chunk>::metadata_at(int x, int y, int z)
+{
+	static constexpr int dim = Chunk::dim;
+	if (x < 0 || y < 0 || z < 0)
+		return nullptr;
+
+	const Chunk* chunk = chunk_at(x / dim, y / dim, z / dim);
+	if (chunk == nullptr)
+		return nullptr;
+	return chunk->metadata_at(x % dim, y % dim, z % dim);
+}
+
+template <class Chunk>
+void BasicChunkGrid<Chunk>::set_metadata(int x, int y, int z, const BlockMetadata& metadata)
+{
+	static constexpr int dim = Chunk::dim;
+	if (x < 0 || y < 0 || z < 0)
+		return;
+
+	// Metadata isn't drawn, so unlike set_block() no halos need updating
+	Chunk* chunk = chunk_at(x / dim, y / dim, z / dim);
+	if (chunk != nullptr)
+		chunk->set_metadata(x % dim, y % dim, z % dim, metadata);
+}
+
+template <class Chunk>
+void BasicChunkGrid<Chunk>::cull(const Frustum& frustum)
+{
+	cull_box_tests = 0;
+	cull_chunks_culled = 0;
+	if (chunks.empty())
+		return;
+	const int lo[3] = { 0, 0, 0 };
+	const int hi[3] = { size_x, size_y, size_z };
+	cull_box(frustum, lo, hi, Frustum::all_planes);
+}
+
+template <class Chunk>
+void BasicChunkGrid<Chunk>::cull_box(const Frustum& frustum, const int lo[3], const int hi[3], uint8_t planes)
+{
+	// lo and hi are in chunks, hi exclusive
+	const int min[3] = { lo[0] * Chunk::dim, lo[1] * Chunk::dim, lo[2] * Chunk::dim };
+	const int max[3] = { hi[0] * Chunk::dim, hi[1] * Chunk::dim, hi[2] * Chunk::dim };
+	++cull_box_tests;
+	const Frustum::Containment containment = frustum.classify(min, max, planes);
+
+	// Halve the box along its longest side, so a long row of chunks
+	// 	(or a column) splits before a short one does
+	int axis = 0;
+	for (int i = 1; i < 3; ++i)
+		if (hi[i] - lo[i] > hi[axis] - lo[axis])
+			axis = i;
+	if (containment != Frustum::Containment::Intersecting || hi[axis] - lo[axis] == 1)
+	{
+		set_containment(lo, hi, containment);
+		return;
+	}
+
+	// Each half only needs the planes the whole box straddled
+	const int mid = (lo[axis] + hi[axis]) / 2;
+	int split_lo[3] = { lo[0], lo[1], lo[2] };
+	int split_hi[3] = { hi[0], hi[1], hi[2] };
+	split_hi[axis] = mid;
+	cull_box(frustum, lo, split_hi, planes);
+	split_lo[axis] = mid;
+	cull_box(frustum, split_lo, hi, planes);
+}
+
+template <class Chunk>
+void BasicChunkGrid<Chunk>::set_containment(const int lo[3], const int hi[3], Frustum::Containment containment)
+{
+	for (int cz = lo[2]; cz < hi[2]; ++cz)
+		for (int cy = lo[1]; cy < hi[1]; ++cy)
+			for (int cx = lo[0]; cx < hi[0]; ++cx)
+				chunk_at(cx, cy, cz)->set_containment(containment);
+	if (containment == Frustum::Containment::Outside)
+		cull_chunks_culled += (hi[0] - lo[0]) * (hi[1] - lo[1]) * (hi[2] - lo[2]);
+}
+
+// The same chunk sizes chunk.cpp instantiates
+template class BasicChunkGrid<BasicCubicChunk<8>>;
+template class BasicChunkGrid<BasicCubicChunk<16>>;
+template class BasicChunkGrid<BasicCubicChunk<32>>;
+#if CHUNK_DIM != 8 && CHUNK_DIM != 16 && CHUNK_DIM != 32
+template class BasicChunkGrid<CubicChunk>;
+#endif
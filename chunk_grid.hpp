@@ -0,0 +1,59 @@
+// chunk_grid.hpp
+
+#pragma once
+
+#include <vector>
+
+#include "chunk.hpp"
+
+// Owns every chunk in the world, laid out in a size_x * size_y * size_z grid
+//	starting at chunk (0, 0, 0), and keeps each chunk's halo (see
+//	CubicChunk::update_halo()) in sync with its neighbours so that faces
+//	between two chunks get culled. Chunk is a BasicCubicChunk of any size.
+template <class Chunk>
+class BasicChunkGrid
+{
+private:
+	const int size_x, size_y, size_z;
+	const CubicChunkBase::MissingNeighbour missing_neighbours;
+
+	// x-major like blocks in LinearLayout. Never resized after the
+	// 	constructor, so pointers into it stay valid.
+	std::vector<Chunk> chunks;
+
+	Chunk* chunk_at(int cx, int cy, int cz);
+	void chunk_created(int cx, int cy, int cz);
+
+	unsigned int cull_box_tests = 0;
+	unsigned int cull_chunks_culled = 0;
+
+	void cull_box(const Frustum& frustum, const int lo[3], const int hi[3], uint8_t planes);
+	void set_containment(const int lo[3], const int hi[3], Frustum::Containment containment);
+
+public:
+	BasicChunkGrid(int size_x, int size_y, int size_z,
+		CubicChunkBase::MissingNeighbour missing_neighbours);
+
+	std::vector<Chunk>& get_chunks() { return chunks; }
+
+	// Takes world block coordinates. Also updates the halo of any
+	//	neighbouring chunk that the block touches.
+	void set_block(int x, int y, int z, blocktype_t block_id);
+
+	// Also take world block coordinates. See BasicCubicChunk::metadata_at().
+	const BlockMetadata* metadata_at(int x, int y, int z);
+	void set_metadata(int x, int y, int z, const BlockMetadata& metadata);
+
+	// Sets every chunk's containment (see BasicCubicChunk::render()) for
+	//	this frame. Boxes of chunks are tested whole and only split while
+	//	they straddle the frustum's edge, so chunks far outside (or well
+	//	inside) the view are settled a box at a time, not one by one.
+	void cull(const Frustum& frustum);
+
+	// How many boxes the last cull() tested, and how many chunks it
+	//	found to be outside
+	unsigned int get_cull_box_tests() const { return cull_box_tests; }
+	unsigned int get_cull_chunks_culled() const { return cull_chunks_culled; }
+};
+
+using ChunkGrid = BasicChunkGrid<CubicChunk>;
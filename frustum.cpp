@@ -0,0 +1,62 @@
+// frustum.cpp
+
+#include "frustum.hpp"
+
+#include "block.hpp"		// for block_size
+
+Frustum Frustum::from_transformation(const MATRIX& matrix)
+{
+	// A point p (in blocks) ends up at row_i . (p * block_size, 1) on axis i.
+	// 	Each plane is a sum of rows: z >= CLIP_PLANE, z + x >= 0, z - x >= 0,
+	// 	and the same for y. nGL clips away anything nearer than CLIP_PLANE,
+	// 	so a box entirely nearer than that would draw nothing anyway.
+	static constexpr int row_signs[plane_count][2] = {
+		{ 0, 0 },
+		{ 1, 0 }, { -1, 0 },
+		{ 0, 1 }, { 0, -1 } };
+
+	Frustum frustum;
+	for (int i = 0; i < plane_count; ++i)
+	{
+		Plane& plane = frustum.planes[i];
+		for (int axis = 0; axis < 4; ++axis)
+		{
+			const int32_t raw = matrix.data[2][axis].value +
+				row_signs[i][0] * matrix.data[0][axis].value +
+				row_signs[i][1] * matrix.data[1][axis].value;
+			if (axis < 3)
+				plane.normal[axis] = raw * Block::block_size;
+			else
+				plane.offset = raw;
+		}
+	}
+	frustum.planes[0].offset -= GLFix{ CLIP_PLANE }.value;
+	return frustum;
+}
+
+Frustum::Containment Frustum::classify(const int min[3], const int max[3], uint8_t& planes) const
+{
+	for (int i = 0; i < plane_count; ++i)
+	{
+		if (!(planes & (1 << i)))
+			continue;
+
+		// The box corner furthest along the normal decides whether any of
+		// 	the box is inside, and the nearest whether all of it is
+		const Plane& plane = this->planes[i];
+		int64_t furthest = plane.offset;
+		int64_t nearest = plane.offset;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const int64_t n = plane.normal[axis];
+			furthest += n * (n >= 0 ? max[axis] : min[axis]);
+			nearest += n * (n >= 0 ? min[axis] : max[axis]);
+		}
+
+		if (furthest < 0)
+			return Containment::Outside;
+		if (nearest >= 0)
+			planes &= ~(1 << i);
+	}
+	return planes == 0 ? Containment::Inside : Containment::Intersecting;
+}
@@ -0,0 +1,42 @@
+// frustum.hpp
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "nGL/gl.h"
+
+// The view volume as planes in world block coordinates, so that boxes of
+//	blocks can be tested against it without transforming or dividing
+//	anything. After the transformation that's z >= CLIP_PLANE (nGL's near
+//	plane), |x| <= z and |y| <= z.
+class Frustum
+{
+public:
+	enum class Containment : uint8_t { Outside, Intersecting, Inside };
+
+	static constexpr int plane_count = 5;
+	static constexpr uint8_t all_planes = (1 << plane_count) - 1;
+
+	// Extracts the planes from the current nGL transformation (which has
+	//	to include the camera, but not a chunk's own offset). Call once per
+	//	frame after the camera is set up.
+	static Frustum from_transformation(const MATRIX& matrix);
+
+	// Where the box from block min to block max (inclusive corners) lies.
+	//	Only the planes set in `planes` are tested, and the ones the box is
+	//	entirely inside of are cleared, so a box inside a bigger one can
+	//	skip the planes the bigger one was already inside of.
+	Containment classify(const int min[3], const int max[3], uint8_t& planes) const;
+
+private:
+	// A point is inside if dot(normal, point) + offset >= 0. Both are raw
+	//	GLFix values, so a sum can need more than 32 bits.
+	struct Plane
+	{
+		std::array<int32_t, 3> normal;
+		int32_t offset;
+	};
+	std::array<Plane, plane_count> planes;
+};
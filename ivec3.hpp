@@ -0,0 +1,48 @@
+// ivec3.hpp
+
+#pragma once
+
+#include <cstdint>
+
+// Integer xyz coordinates for use inside a chunk.
+// 	Block and lattice coordinates are always whole numbers, so there's no
+// 	point doing their math in GLFix. VECTOR3 is for positions that go
+// 	to nGL.
+template <typename T>
+struct basic_ivec3
+{
+	T x, y, z;
+
+	template <typename U>
+	constexpr basic_ivec3<int> operator+(const basic_ivec3<U>& other) const
+	{
+		return { x + other.x, y + other.y, z + other.z };
+	}
+
+	template <typename U>
+	constexpr basic_ivec3<int> operator-(const basic_ivec3<U>& other) const
+	{
+		return { x - other.x, y - other.y, z - other.z };
+	}
+
+	constexpr basic_ivec3<int> operator*(int scale) const
+	{
+		return { x * scale, y * scale, z * scale };
+	}
+
+	constexpr bool operator==(const basic_ivec3& other) const
+	{
+		return x == other.x && y == other.y && z == other.z;
+	}
+
+	constexpr bool operator!=(const basic_ivec3& other) const { return !(*this == other); }
+
+	constexpr basic_ivec3<int> widen() const { return { x, y, z }; }
+};
+
+// What the hot loops work in
+using ivec3 = basic_ivec3<int>;
+
+// 3 bytes instead of 12, for small offsets like the face tables that we
+// 	want to stay in cache. Any math on them gives an ivec3.
+using ivec3_s8 = basic_ivec3<int8_t>;
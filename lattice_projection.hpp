@@ -0,0 +1,172 @@
+// lattice_projection.hpp
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "nGL/gl.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Where the camera sees a chunk's lattice points (block corners), before the
+//	perspective divide. The transformation is affine up to there, so point
+//	(x, y, z) is origin + (x * edges[0] + y * edges[1] + z * edges[2]) / dim,
+//	where edges are the chunk's sides along each axis.
+//
+// at() is the reference. project() does the same for a batch of points in
+//	structure-of-arrays form, and gives bit-identical results: GLFix * int
+//	and GLFix / int work on the raw value, so it's all 32-bit integer math
+//	with a division that rounds towards zero.
+template <int dim>
+struct LatticeProjection
+{
+	VECTOR3 origin;
+	std::array<VECTOR3, 3> edges;
+
+	VECTOR3 at(int x, int y, int z) const
+	{
+		return origin + (edges[0] * x + edges[1] * y + edges[2] * z) / dim;
+	}
+
+	// Which version of project() this build uses
+#if defined(__arm__) && defined(__ARM_FEATURE_DSP)
+	static constexpr const char* kernel_name = "armv5te";
+#elif defined(__SSE2__)
+	static constexpr const char* kernel_name = "sse2";
+#else
+	static constexpr const char* kernel_name = "scalar";
+#endif
+
+	// Lattice coordinates are at most dim, so 16 bits is plenty
+	void project(const int16_t* xs, const int16_t* ys, const int16_t* zs, int count,
+		GLFix* out_x, GLFix* out_y, GLFix* out_z) const
+	{
+		project_axis(xs, ys, zs, count, origin.x, edges[0].x, edges[1].x, edges[2].x, out_x);
+		project_axis(xs, ys, zs, count, origin.y, edges[0].y, edges[1].y, edges[2].y, out_y);
+		project_axis(xs, ys, zs, count, origin.z, edges[0].z, edges[1].z, edges[2].z, out_z);
+	}
+
+private:
+	// Quotient rounded towards zero, like the / in at(). For a power of two
+	//	that's a shift, once negative numbers are biased up by dim - 1.
+	static constexpr bool dim_is_pow2 = (dim & (dim - 1)) == 0;
+	static constexpr int dim_shift = dim <= 1 ? 0 : dim <= 2 ? 1 : dim <= 4 ? 2 :
+		dim <= 8 ? 3 : dim <= 16 ? 4 : dim <= 32 ? 5 : 6;
+
+	static int32_t divide(int32_t n)
+	{
+		return n / dim;
+	}
+
+	// The multiplies and adds wrap like the int math in GLFix does, so
+	//	they're done unsigned to keep that well defined
+	static int32_t numerator(int32_t ex, int32_t ey, int32_t ez, int x, int y, int z)
+	{
+		return int32_t(uint32_t(ex) * uint32_t(x) + uint32_t(ey) * uint32_t(y) + uint32_t(ez) * uint32_t(z));
+	}
+
+#if defined(__arm__) && defined(__ARM_FEATURE_DSP)
+	// ARMv5TE's 16 x 16 bit multiply-accumulates. An edge is 32 bits, so we
+	//	split it into a signed low half and the high half that's left over
+	//	(edge = (high << 16) + low) and pack both into one register; the
+	//	T/B variants then pick the half to multiply by.
+	static int32_t pack_halves(int32_t e)
+	{
+		const int32_t low = int16_t(e & 0xffff);
+		const int32_t high = (e - low) >> 16;
+		return int32_t(uint32_t(high) << 16 | (uint32_t(low) & 0xffff));
+	}
+
+	static int32_t smulbb(int32_t a, int32_t b)
+	{
+		int32_t r;
+		asm("smulbb %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+		return r;
+	}
+	static int32_t smlabb(int32_t a, int32_t b, int32_t acc)
+	{
+		int32_t r;
+		asm("smlabb %0, %1, %2, %3" : "=r"(r) : "r"(a), "r"(b), "r"(acc));
+		return r;
+	}
+	static int32_t smultb(int32_t a, int32_t b)
+	{
+		int32_t r;
+		asm("smultb %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+		return r;
+	}
+	static int32_t smlatb(int32_t a, int32_t b, int32_t acc)
+	{
+		int32_t r;
+		asm("smlatb %0, %1, %2, %3" : "=r"(r) : "r"(a), "r"(b), "r"(acc));
+		return r;
+	}
+
+	static void project_axis(const int16_t* xs, const int16_t* ys, const int16_t* zs, int count,
+		GLFix base, GLFix ex, GLFix ey, GLFix ez, GLFix* out)
+	{
+		const int32_t px = pack_halves(ex.value);
+		const int32_t py = pack_halves(ey.value);
+		const int32_t pz = pack_halves(ez.value);
+		for (int i = 0; i < count; ++i)
+		{
+			const int32_t low = smlabb(pz, zs[i], smlabb(py, ys[i], smulbb(px, xs[i])));
+			const int32_t high = smlatb(pz, zs[i], smlatb(py, ys[i], smultb(px, xs[i])));
+			const int32_t n = int32_t((uint32_t(high) << 16) + uint32_t(low));
+			out[i].value = base.value + divide(n);
+		}
+	}
+#elif defined(__SSE2__)
+	// Four points at a time. SSE2 has no 32-bit multiply that keeps the low
+	//	half, so we use the 32 x 32 -> 64 bit one on the even and odd lanes
+	//	and put the low halves back together.
+	static __m128i mullo(__m128i a, __m128i b)
+	{
+		const __m128i even = _mm_mul_epu32(a, b);
+		const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	static __m128i load4(const int16_t* c)
+	{
+		const __m128i c16 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(c));
+		return _mm_srai_epi32(_mm_unpacklo_epi16(c16, c16), 16);
+	}
+
+	static void project_axis(const int16_t* xs, const int16_t* ys, const int16_t* zs, int count,
+		GLFix base, GLFix ex, GLFix ey, GLFix ez, GLFix* out)
+	{
+		int i = 0;
+		if constexpr (dim_is_pow2)
+		{
+			static_assert(sizeof(GLFix) == sizeof(int32_t), "GLFix is stored as its raw int");
+			const __m128i vex = _mm_set1_epi32(ex.value);
+			const __m128i vey = _mm_set1_epi32(ey.value);
+			const __m128i vez = _mm_set1_epi32(ez.value);
+			const __m128i vbase = _mm_set1_epi32(base.value);
+			const __m128i bias = _mm_set1_epi32(dim - 1);
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128i n = _mm_add_epi32(_mm_add_epi32(
+					mullo(vex, load4(xs + i)), mullo(vey, load4(ys + i))), mullo(vez, load4(zs + i)));
+				const __m128i biased = _mm_add_epi32(n, _mm_and_si128(_mm_srai_epi32(n, 31), bias));
+				const __m128i q = _mm_srai_epi32(biased, dim_shift);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_add_epi32(vbase, q));
+			}
+		}
+		for (; i < count; ++i)
+			out[i].value = base.value + divide(numerator(ex.value, ey.value, ez.value, xs[i], ys[i], zs[i]));
+	}
+#else
+	static void project_axis(const int16_t* xs, const int16_t* ys, const int16_t* zs, int count,
+		GLFix base, GLFix ex, GLFix ey, GLFix ez, GLFix* out)
+	{
+		for (int i = 0; i < count; ++i)
+			out[i].value = base.value + divide(numerator(ex.value, ey.value, ez.value, xs[i], ys[i], zs[i]));
+	}
+#endif
+};
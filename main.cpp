@@ -1,6 +1,9 @@
 
+#include <algorithm>
 #include <string>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include <os.h>
 #include <libndls.h>
@@ -16,6 +19,8 @@
 
 #include "player.hpp"
 #include "chunk.hpp"
+#include "chunk_grid.hpp"
+#include "benchmark.hpp"
 
 // NOTE: currently this function is horrendously slow, using around 5ms (really???)
 // 		If we pre-generate the dithered z-buffer and just copy it over each frame, we could
@@ -43,6 +48,9 @@ void dither_z_buffer(const uint16_t max_dist)
 int main()
 {
 	GLFix texture_render_dist = 16;
+
+	// How long each frame may spend building chunk meshes
+	unsigned int mesh_budget_us = 4000;
 	nglInit();
 	glBindTexture(&tex_spritesheet);
 
@@ -59,24 +67,22 @@ int main()
 	Player player;
 	player.pos = { Block::block_size * CubicChunk::dim * 1, 0, Block::block_size * CubicChunk::dim * -2 };
 
-	std::vector<CubicChunk> chunks;
-	// CubicChunk chunk{VECTOR3{0, 0, 0}};
-	// chunks.push_back(chunk);
-	for (int z = 0; z < 1; z++)
-	{
-		for (int y = 0; y < 1; y++)
-		{
-			for (int x = 0; x < 1; x++)
-			{
-				CubicChunk chunk{
-					VECTOR3{x * CubicChunk::dim,
-							y * CubicChunk::dim,
-							z * CubicChunk::dim}
-				};
-				chunks.push_back(chunk);
-			}
-		}
-	}
+	// Faces between chunks are culled. At the edge of the world we still
+	// 	draw them, so the terrain doesn't look hollow from outside.
+	ChunkGrid world{ 1, 1, 1, CubicChunk::MissingNeighbour::Air };
+	std::vector<CubicChunk>& chunks = world.get_chunks();
+
+	// Buffers every chunk uses while it's being drawn
+	RenderScratch render_scratch;
+
+	// Filled from the nearest few chunks each frame, so that render() can
+	// 	skip chunks hidden behind them
+	static OcclusionBuffer occlusion;
+	static constexpr int occluder_chunks = 4;
+	bool occlusion_culling = true;
+
+	// Chunks nearest first, with their distance from the player
+	std::vector<std::pair<GLFix, CubicChunk*>> draw_order;
 
 	Stopwatch total_stopwatch;
 	total_stopwatch.start();
@@ -90,6 +96,11 @@ int main()
 	int resolution_options[] = { 80, 160, 320 };
 	int resolution_index = 2;
 
+	bool meshers_agree = true;
+	bool palette_ok = true;
+	std::string benchmark_results;
+	bool run_benchmarks = false;
+
 	unsigned int frame = 0;
 	while (!isKeyPressed(KEY_NSPIRE_ESC))
 	{
@@ -122,6 +133,27 @@ int main()
 		}
 		if (isKeyPressed(KEY_NSPIRE_R))
 			resolution_index = (resolution_index + 1) % 3;
+		if (isKeyPressed(KEY_NSPIRE_M))
+		{
+			// Cycles Scan -> Bitmask -> Specialised -> Scan
+			CubicChunk::Mesher mesher = chunks[0].get_mesher() == CubicChunk::Mesher::Scan
+				? CubicChunk::Mesher::Bitmask
+				: chunks[0].get_mesher() == CubicChunk::Mesher::Bitmask
+				? CubicChunk::Mesher::Specialised : CubicChunk::Mesher::Scan;
+			for (CubicChunk& chunk : chunks)
+				chunk.set_mesher(mesher);
+		}
+		if (isKeyPressed(KEY_NSPIRE_T))
+		{
+			meshers_agree = true;
+			for (const CubicChunk& chunk : chunks)
+				meshers_agree = meshers_agree && chunk.meshers_agree();
+			palette_ok = PalettedBlocks<CubicChunk::size>::round_trip_ok();
+		}
+		if (isKeyPressed(KEY_NSPIRE_B))
+			run_benchmarks = true;
+		if (isKeyPressed(KEY_NSPIRE_O))
+			occlusion_culling = !occlusion_culling;
 
 		if (any_key_pressed() || touchpad.is_touched())
 			ms_since_last_input = 0;
@@ -144,34 +176,132 @@ int main()
 		nglRotateY(GLFix{ 360 } - player.angle.y);
 		glTranslatef(-player.pos.x, -player.pos.y, -player.pos.z);
 
+		// The chunk size benchmark draws from the camera, so the benchmarks
+		// 	wait until it's set up. Then we clear away what it drew.
+		if (run_benchmarks)
+		{
+			benchmark_results = benchmark_meshers(chunks, lap_stopwatch);
+			benchmark_results += benchmark_layout(chunks[0], lap_stopwatch);
+			benchmark_results += benchmark_chunk_sizes(player.pos, lap_stopwatch);
+			benchmark_results += benchmark_projection(lap_stopwatch);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			run_benchmarks = false;
+		}
+
+		world.cull(Frustum::from_transformation(*transformation));
+
 		debug_info << "render setup:" << lap_stopwatch.get_ms() << "\n";
 
 
-		int vertex_count = 0;
+		// Spread meshing over frames. Chunks keep drawing their old mesh
+		// 	until the new one is finished.
+		const double mesh_start_ms = lap_stopwatch.get_ms();
+		int pending_meshes = 0;
 		for (CubicChunk& chunk : chunks)
 		{
-			if (chunk.taxidist_to(player.pos / Block::block_size) > texture_render_dist) {
+			const unsigned int spent_us = (lap_stopwatch.get_ms() - mesh_start_ms) * 1000;
+			if (spent_us < mesh_budget_us)
+				chunk.advance_mesh_for(mesh_budget_us - spent_us, lap_stopwatch);
+			pending_meshes += chunk.mesh_pending();
+		}
 
-				chunk.disable_textures();
-				chunk.set_greed_limit(4);
-			}
-			else {
-				chunk.enable_textures();
-				chunk.set_greed_limit(1);
+		debug_info << "mesh:" << lap_stopwatch.get_ms() << "\n";
+
+		// Nearest chunks first. They supply the occluders, and drawing front
+		// 	to back lets the z-buffer reject more of what's behind.
+		draw_order.clear();
+		for (CubicChunk& chunk : chunks)
+			draw_order.emplace_back(chunk.taxidist_to(player.pos / Block::block_size), &chunk);
+		std::sort(draw_order.begin(), draw_order.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+
+		const double occluders_start_ms = lap_stopwatch.get_ms();
+		occlusion.clear();
+		if (occlusion_culling)
+		{
+			int added = 0;
+			for (auto& [dist, chunk] : draw_order)
+			{
+				if (added == occluder_chunks)
+					break;
+				if (chunk->get_containment() == Frustum::Containment::Outside)
+					continue;
+				chunk->add_occluders(occlusion, player.pos);
+				++added;
 			}
-			vertex_count += chunk.render(player.pos, debug_info, lap_stopwatch);
+			render_scratch.occlusion = &occlusion;
+		}
+		const double occluders_ms = lap_stopwatch.get_ms() - occluders_start_ms;
+
+		debug_info << "occluders:" << lap_stopwatch.get_ms() << "\n";
+
+		int vertex_count = 0;
+		unsigned int points_projected = 0;
+		unsigned int quads_drawn = 0;
+		unsigned int quads_inside = 0;
+		int occluded_chunks = 0;
+		double occlusion_test_ms = 0;
+		unsigned int mesh_cache_hits = 0;
+		unsigned int mesh_cache_misses = 0;
+		unsigned int mesh_cache_bytes = 0;
+		unsigned int block_bytes = 0;
+		int uniform_chunks = 0;
+		unsigned int chunk_bytes = 0;
+		for (auto& [dist, chunk] : draw_order)
+		{
+			if (dist > texture_render_dist)
+				chunk->set_lod(false, 4);
+			else
+				chunk->set_lod(true, CubicChunk::dim);
+			vertex_count += chunk->render(player.pos, render_scratch, debug_info, lap_stopwatch);
+			const CubicChunk::RenderStats& stats = chunk->get_render_stats();
+			points_projected += stats.points_projected;
+			quads_drawn += stats.quads_drawn;
+			quads_inside += stats.quads_inside;
+			occluded_chunks += stats.occluded;
+			occlusion_test_ms += stats.occlusion_ms;
+			mesh_cache_hits += chunk->get_mesh_cache_hits();
+			mesh_cache_misses += chunk->get_mesh_cache_misses();
+			mesh_cache_bytes += chunk->get_mesh_cache_bytes();
+			block_bytes += chunk->get_block_bytes();
+			uniform_chunks += chunk->is_uniform();
+			chunk_bytes += chunk->memory_usage();
 			// if (lap_stopwatch.get_ms() > (1000 / 12)) break;
 		}
+		render_scratch.occlusion = nullptr;
 
 		if (frame)
 		{
 			debug_info << static_cast<int>(1000.0f / frame_times.get<double>()) << "FPS; ";
 			debug_info << frame_times.get<int>() << " mspt\n";
 
-			debug_info << vertex_count << " verts\n";
+			debug_info << vertex_count << " verts " << points_projected << " projected\n";
+			debug_info << "frustum: " << world.get_cull_box_tests() << " tests ";
+			debug_info << world.get_cull_chunks_culled() << "/" << chunks.size() << " culled; quads: ";
+			debug_info << quads_inside << " inside " << quads_drawn - quads_inside << " intersecting\n";
+			debug_info << "occlusion" << (occlusion_culling ? ": " : " off: ");
+			debug_info << occlusion.get_occluder_count() << " quads " << occluders_ms << "ms, ";
+			debug_info << occluded_chunks << " culled " << occlusion_test_ms << "ms\n";
 
 			debug_info << "greed=" << chunks[0].get_greed_limit() << "; ";
 			debug_info << "res=" << resolution_options[resolution_index] << "\n";
+
+			static constexpr const char* mesher_names[] = { "scan", "bitmask", "specialised" };
+			debug_info << "mesher=" << mesher_names[static_cast<int>(chunks[0].get_mesher())];
+			debug_info << (meshers_agree ? "" : " (MISMATCH)");
+			debug_info << (palette_ok ? "" : " (PALETTE BROKEN)") << "\n";
+			debug_info << benchmark_results;
+
+			debug_info << "meshes: " << mesh_cache_hits << " hit " << mesh_cache_misses << " miss ";
+			debug_info << mesh_cache_bytes / 1024 << "KB " << pending_meshes << " pending\n";
+
+			// Unpacked, blocks took CubicChunk::size * sizeof(Block) per chunk
+			debug_info << "blocks: " << block_bytes / chunks.size() << "B/chunk (was ";
+			debug_info << CubicChunk::size * sizeof(Block) << "B) ";
+			debug_info << uniform_chunks << " uniform\n";
+			debug_info << "mem: " << chunk_bytes / chunks.size() / 1024 << "KB/chunk + ";
+			debug_info << render_scratch.memory_usage() / 1024 << "KB scratch + ";
+			debug_info << occlusion.memory_usage() / 1024 << "KB occlusion\n";
 		}
 
 		glPopMatrix();
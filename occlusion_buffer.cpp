@@ -0,0 +1,161 @@
+// occlusion_buffer.cpp
+
+#include "occlusion_buffer.hpp"
+
+#include <algorithm>
+#include <climits>
+
+// GLFix{ 1 }.value, i.e. one pixel in a ScreenPoint
+static constexpr int64_t one_pixel = 1 << 8;
+
+// How far inside an occluder's edges (in ScreenPoint units) a point has to
+// 	be to count as covered
+static constexpr int64_t edge_margin = one_pixel / 16;
+
+// How far off screen (in ScreenPoint units) an occluder's corners can be
+static constexpr int64_t max_offscreen = one_pixel << 16;
+
+// The pixels from first to end (exclusive) that something spanning min to
+// 	max (in ScreenPoint units) touches, cut to the size pixels on screen
+static void pixel_span(int64_t min, int64_t max, int size, int& first, int& end)
+{
+	first = std::clamp<int64_t>(min / one_pixel, 0, size);
+	end = std::clamp<int64_t>((max + one_pixel - 1) / one_pixel, 0, size);
+}
+
+void OcclusionBuffer::clear()
+{
+	depths.fill(INT32_MAX);
+	occluder_count = 0;
+}
+
+OcclusionBuffer::ScreenPoint OcclusionBuffer::to_screen(const VECTOR3& p)
+{
+	// x / z and y / z go from -1 to 1 across the screen. Dividing the raw
+	// 	values ourselves keeps the 64 bits that GLFix division wouldn't.
+	static constexpr int64_t half_width = width / 2, half_height = height / 2;
+	return ScreenPoint{
+		half_width * one_pixel + int64_t(p.x.value) * half_width * one_pixel / p.z.value,
+		half_height * one_pixel - int64_t(p.y.value) * half_height * one_pixel / p.z.value };
+}
+
+void OcclusionBuffer::add_occluder(const std::array<VECTOR3, 4>& quad)
+{
+	std::array<ScreenPoint, 4> points;
+	int32_t max_depth = INT32_MIN;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (quad[i].z < GLFix{ CLIP_PLANE })
+			return;
+		points[i] = to_screen(quad[i]);
+		// Leaving out an occluder is always safe, and keeps the edge
+		// 	functions below well inside 64 bits
+		if (points[i].x < -max_offscreen || points[i].x > max_offscreen ||
+			points[i].y < -max_offscreen || points[i].y > max_offscreen)
+			return;
+		max_depth = std::max(max_depth, quad[i].z.value);
+	}
+
+	// The pixels the quad might touch
+	int64_t min_x = points[0].x, max_x = points[0].x;
+	int64_t min_y = points[0].y, max_y = points[0].y;
+	for (const ScreenPoint& p : points)
+	{
+		min_x = std::min(min_x, p.x);
+		max_x = std::max(max_x, p.x);
+		min_y = std::min(min_y, p.y);
+		max_y = std::max(max_y, p.y);
+	}
+	int x0, x1, y0, y1;
+	pixel_span(min_x, max_x, width, x0, x1);
+	pixel_span(min_y, max_y, height, y0, y1);
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	// Which way round the corners go, so that inside is where every
+	// 	edge function is >= 0. Seen edge on, the quad covers nothing.
+	int64_t area = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		const ScreenPoint& a = points[i];
+		const ScreenPoint& b = points[(i + 1) % 4];
+		area += a.x * b.y - b.x * a.y;
+	}
+	if (area == 0)
+		return;
+	const int64_t sign = area > 0 ? 1 : -1;
+
+	// A point has to be a little way inside each edge to count, since
+	// 	to_screen() rounds. The edge function is the distance from the
+	// 	edge times the edge's length, which |dx| + |dy| is at least.
+	const auto inside = [&](int gx, int gy)
+	{
+		const int64_t x = gx * one_pixel, y = gy * one_pixel;
+		for (int i = 0; i < 4; ++i)
+		{
+			const ScreenPoint& a = points[i];
+			const ScreenPoint& b = points[(i + 1) % 4];
+			const int64_t dx = b.x - a.x, dy = b.y - a.y;
+			const int64_t margin = edge_margin * ((dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy));
+			if (sign * (dx * (y - a.y) - dy * (x - a.x)) < margin)
+				return false;
+		}
+		return true;
+	};
+
+	// The quad is convex, so it covers a whole pixel if it covers all
+	// 	four of the pixel's corners. Each row of corners is shared by two
+	// 	rows of pixels.
+	std::array<bool, width + 1> above, below;
+	for (int gx = x0; gx <= x1; ++gx)
+		above[gx] = inside(gx, y0);
+	for (int y = y0; y < y1; ++y)
+	{
+		for (int gx = x0; gx <= x1; ++gx)
+			below[gx] = inside(gx, y + 1);
+		for (int x = x0; x < x1; ++x)
+		{
+			if (above[x] && above[x + 1] && below[x] && below[x + 1])
+			{
+				int32_t& depth = depths[x + y * width];
+				depth = std::min(depth, max_depth);
+			}
+		}
+		above = below;
+	}
+	++occluder_count;
+}
+
+bool OcclusionBuffer::occludes(const std::array<VECTOR3, 8>& box) const
+{
+	// The box is hidden if even its nearest corner is behind the occluders
+	// 	at every pixel the box might touch. Its outline on screen lies
+	// 	within its corners' bounding rectangle.
+	int32_t min_depth = INT32_MAX;
+	int64_t min_x = INT64_MAX, max_x = INT64_MIN;
+	int64_t min_y = INT64_MAX, max_y = INT64_MIN;
+	for (const VECTOR3& corner : box)
+	{
+		// Part of the box is too near to say anything about
+		if (corner.z < GLFix{ CLIP_PLANE })
+			return false;
+		const ScreenPoint p = to_screen(corner);
+		min_depth = std::min(min_depth, corner.z.value);
+		min_x = std::min(min_x, p.x);
+		max_x = std::max(max_x, p.x);
+		min_y = std::min(min_y, p.y);
+		max_y = std::max(max_y, p.y);
+	}
+
+	int x0, x1, y0, y1;
+	pixel_span(min_x, max_x, width, x0, x1);
+	pixel_span(min_y, max_y, height, y0, y1);
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	for (int y = y0; y < y1; ++y)
+		for (int x = x0; x < x1; ++x)
+			if (depths[x + y * width] >= min_depth)
+				return false;
+	return true;
+}
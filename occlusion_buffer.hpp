@@ -0,0 +1,49 @@
+// occlusion_buffer.hpp
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "nGL/gl.h"
+
+// A coarse picture of what the nearest geometry hides, for skipping chunks
+//	that would only lose every depth test. Each pixel holds a depth (camera
+//	z) beyond which everything along that pixel is hidden. Occluders only
+//	count for the pixels they cover entirely, and a chunk only counts as
+//	hidden if every pixel its box might touch hides it, so nothing visible
+//	gets culled.
+//
+// Everything is in camera space, i.e. after the transformation, with the
+//	same |x| <= z, |y| <= z screen as Frustum.
+class OcclusionBuffer
+{
+public:
+	static constexpr int width = 80;
+	static constexpr int height = 60;
+
+	// Forgets every occluder. Call once per frame before adding any.
+	void clear();
+
+	// Adds a convex quad (corners in order around it) of opaque geometry.
+	//	Quads reaching in front of the near plane are ignored.
+	void add_occluder(const std::array<VECTOR3, 4>& quad);
+
+	// Whether the box with these corners is hidden by the occluders
+	bool occludes(const std::array<VECTOR3, 8>& box) const;
+
+	unsigned int get_occluder_count() const { return occluder_count; }
+
+	unsigned int memory_usage() const { return sizeof(*this); }
+
+private:
+	// Raw GLFix depths. Pixels nothing covers hold INT32_MAX.
+	std::array<int32_t, width * height> depths;
+	unsigned int occluder_count = 0;
+
+	// Screen position in pixels, as raw GLFix values (so with 8 bits of
+	//	fraction). Kept as 64 bits since points near the edge of the view
+	//	can land far off screen.
+	struct ScreenPoint { int64_t x, y; };
+	static ScreenPoint to_screen(const VECTOR3& p);
+};
@@ -0,0 +1,92 @@
+// render_scratch.hpp
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "nGL/gl.h"
+#include "nGL/gldrawarray.h"
+
+#include "lattice_projection.hpp"
+#include "occlusion_buffer.hpp"
+
+// The buffers CubicChunk::render() only needs while it's drawing one chunk.
+//	Whoever draws the chunks owns one of these and passes it to every
+//	render() call, so chunks (of any size) don't each keep their own.
+struct RenderScratch
+{
+	// How many quads render() expands into `vertices` at a time
+	static constexpr int batch_quads = 128;
+
+	// The projected lattice points of the chunk being drawn, indexed by
+	//	its xyz_to_vert_idx(). Only entries whose projection_stamps entry is
+	//	projection_stamp were filled in for this chunk.
+	std::vector<ProcessedPosition> processed;
+	std::vector<uint16_t> projection_stamps;
+	uint16_t projection_stamp = 0;
+
+	std::array<IndexedVertex, 4 * batch_quads> vertices;
+
+	// If set, render() skips chunks this says are hidden. The owner of the
+	//	buffer sets it while drawing the frame it was filled for.
+	const OcclusionBuffer* occlusion = nullptr;
+
+	// Lattice points waiting to be projected, in the structure-of-arrays
+	//	form LatticeProjection::project() takes, and the processed index
+	//	each one goes to
+	static constexpr int batch_points = 256;
+	std::array<int16_t, batch_points> batch_x, batch_y, batch_z;
+	std::array<unsigned int, batch_points> batch_idx;
+	std::array<GLFix, batch_points> projected_x, projected_y, projected_z;
+	int batch_size = 0;
+
+	// Queues a point, projecting the batch once it's full
+	template <int dim>
+	void queue_point(const LatticeProjection<dim>& lattice, int x, int y, int z, unsigned int idx)
+	{
+		batch_x[batch_size] = x;
+		batch_y[batch_size] = y;
+		batch_z[batch_size] = z;
+		batch_idx[batch_size] = idx;
+		if (++batch_size == batch_points)
+			flush_points(lattice);
+	}
+
+	template <int dim>
+	void flush_points(const LatticeProjection<dim>& lattice)
+	{
+		lattice.project(batch_x.data(), batch_y.data(), batch_z.data(), batch_size,
+			projected_x.data(), projected_y.data(), projected_z.data());
+		for (int i = 0; i < batch_size; ++i)
+			processed[batch_idx[i]] = ProcessedPosition{
+				{ projected_x[i], projected_y[i], projected_z[i] }, { 0, 0, 0 }, false };
+		batch_size = 0;
+	}
+
+	// Gets ready to draw a chunk with `points` lattice points. Bumping the
+	//	stamp marks every point as not yet projected. The buffers only ever
+	//	grow, so they end up the size of the biggest chunk drawn.
+	void begin_chunk(unsigned int points)
+	{
+		if (processed.size() < points)
+		{
+			processed.resize(points);
+			projection_stamps.resize(points, 0);
+		}
+		if (++projection_stamp == 0)
+		{
+			std::fill(projection_stamps.begin(), projection_stamps.end(), 0);
+			projection_stamp = 1;
+		}
+	}
+
+	unsigned int memory_usage() const
+	{
+		return sizeof(*this) +
+			processed.capacity() * sizeof(ProcessedPosition) +
+			projection_stamps.capacity() * sizeof(uint16_t);
+	}
+};